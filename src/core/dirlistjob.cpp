@@ -1,5 +1,6 @@
 #include "dirlistjob.h"
 #include <gio/gio.h>
+#include <algorithm>
 #include "fileinfo_p.h"
 #include "gioptrs.h"
 #include <QDebug>
@@ -7,7 +8,21 @@
 namespace Fm {
 
 DirListJob::DirListJob(const FilePath& path, Flags _flags, const std::shared_ptr<const HashSet>& cutFilesHashSet):
-    dir_path{path}, flags{_flags}, cutFilesHashSet_{cutFilesHashSet} {
+    dir_path{path},
+    flags{_flags},
+    cutFilesHashSet_{cutFilesHashSet},
+    emit_files_found{false},
+    childAttribs_{nullptr},
+    batchSize_{1000},
+    batchInterval_{250},
+    load_snapshot{false},
+    has_dir_stamp{false} {
+}
+
+void DirListJob::setIncremental(bool set, size_t batchSize, int batchInterval) {
+    emit_files_found = set;
+    batchSize_ = std::max(batchSize, size_t{1});
+    batchInterval_ = batchInterval;
 }
 
 void DirListJob::exec() {
@@ -55,12 +70,65 @@ _retry:
         dir_fi = std::make_shared<FileInfo>(dir_inf, dir_path);
     }
 
+    // The stamp is taken before listing the folder, so that a change during the listing
+    // invalidates the snapshot saved after it. Loading the snapshot is done here rather
+    // than in the main thread, since it creates the info of every file.
+    if(load_snapshot && dir_path.isNative()) {
+        FolderSnapshot::DirStamp stamp;
+        bool hasStamp = FolderSnapshot::dirStamp(dir_path, stamp);
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            dir_stamp = stamp;
+            has_dir_stamp = hasStamp;
+        }
+        FileInfoList snapshotFiles;
+        if(hasStamp && FolderSnapshot::load(dir_path, stamp, snapshotFiles)
+           && !snapshotFiles.empty() && !isCancelled()) {
+            Q_EMIT snapshotLoaded(snapshotFiles);
+        }
+    }
+
+    // a fast listing does not sniff the content of the files
+    childAttribs_ = (flags & DETAILED) ? defaultGFileInfoQueryAttribs : fastGFileInfoQueryAttribs;
+
     FileInfoList foundFiles;
+    batchTimer_.start();
+    listDir(dir_gfile, isFileSearch, foundFiles);
+
+    // qDebug() << "END LISTING:" << dir_path.toString().get();
+    if(emit_files_found && !foundFiles.empty() && !isCancelled()) {
+        Q_EMIT filesFound(foundFiles);
+        foundFiles.clear();
+    }
+    if(!foundFiles.empty()) {
+        std::lock_guard<std::mutex> lock{mutex_};
+        files_.swap(foundFiles);
+    }
+}
+
+void DirListJob::addFoundFile(FileInfoList& foundFiles, std::shared_ptr<FileInfo> fileInfo) {
+    if(cutFilesHashSet_
+            && cutFilesHashSet_->count(fileInfo->pathHash()) > 0) {
+        fileInfo->bindCutFiles(cutFilesHashSet_);
+    }
+
+    foundFiles.push_back(std::move(fileInfo));
+
+    // deliver the files found so far without waiting for the end of the listing
+    if(emit_files_found
+       && (foundFiles.size() >= batchSize_ || batchTimer_.elapsed() >= batchInterval_)) {
+        Q_EMIT filesFound(foundFiles);
+        foundFiles.clear();
+        batchTimer_.restart();
+    }
+}
+
+void DirListJob::listDir(const GFilePtr& dir_gfile, bool isFileSearch, FileInfoList& foundFiles) {
     /* check if FS is R/O and set attr. into inf */
     // FIXME:  _fm_file_info_job_update_fs_readonly(gf, inf, nullptr, nullptr);
-    err.reset();
+    GErrorPtr err;
     GFileEnumeratorPtr enu = GFileEnumeratorPtr{
-            g_file_enumerate_children(dir_gfile.get(), defaultGFileInfoQueryAttribs,
+            g_file_enumerate_children(dir_gfile.get(), childAttribs_,
                                       G_FILE_QUERY_INFO_NONE, cancellable().get(), &err),
             false
     };
@@ -101,17 +169,7 @@ _retry:
                 }
                 fi = fm_file_info_new_from_g_file_data(child, inf, sub);
 #endif
-                auto fileInfo = std::make_shared<FileInfo>(inf, FilePath(), realParentPath);
-                if(emit_files_found) {
-                    // Q_EMIT filesFound();
-                }
-
-                if(cutFilesHashSet_
-                        && cutFilesHashSet_->count(fileInfo->path().hash()) > 0) {
-                    fileInfo->bindCutFiles(cutFilesHashSet_);
-                }
-
-                foundFiles.push_back(std::move(fileInfo));
+                addFoundFile(foundFiles, std::make_shared<FileInfo>(inf, FilePath(), realParentPath));
             }
             else {
                 if(err) {
@@ -133,50 +191,6 @@ _retry:
                        ? ErrorSeverity::MILD // may happen at Folder::reload()
                        : ErrorSeverity::CRITICAL);
     }
-
-    // qDebug() << "END LISTING:" << dir_path.toString().get();
-    if(!foundFiles.empty()) {
-        std::lock_guard<std::mutex> lock{mutex_};
-        files_.swap(foundFiles);
-    }
 }
 
-#if 0
-//FIXME: incremental..
-
-static gboolean emit_found_files(gpointer user_data) {
-    /* this callback is called from the main thread */
-    FmDirListJob* job = FM_DIR_LIST_JOB(user_data);
-    /* g_print("emit_found_files: %d\n", g_slist_length(job->files_to_add)); */
-
-    if(g_source_is_destroyed(g_main_current_source())) {
-        return FALSE;
-    }
-    g_signal_emit(job, signals[FILES_FOUND], 0, job->files_to_add);
-    g_slist_free_full(job->files_to_add, (GDestroyNotify)fm_file_info_unref);
-    job->files_to_add = nullptr;
-    job->delay_add_files_handler = 0;
-    return FALSE;
-}
-
-static gpointer queue_add_file(FmJob* fmjob, gpointer user_data) {
-    FmDirListJob* job = FM_DIR_LIST_JOB(fmjob);
-    FmFileInfo* file = FM_FILE_INFO(user_data);
-    /* this callback is called from the main thread */
-    /* g_print("queue_add_file: %s\n", fm_file_info_get_disp_name(file)); */
-    job->files_to_add = g_slist_prepend(job->files_to_add, fm_file_info_ref(file));
-    if(job->delay_add_files_handler == 0)
-        job->delay_add_files_handler = g_timeout_add_seconds_full(G_PRIORITY_LOW,
-                                       1, emit_found_files, g_object_ref(job), g_object_unref);
-    return nullptr;
-}
-
-void fm_dir_list_job_add_found_file(FmDirListJob* job, FmFileInfo* file) {
-    fm_file_info_list_push_tail(job->files, file);
-    if(G_UNLIKELY(job->emit_files_found)) {
-        fm_job_call_main_thread(FM_JOB(job), queue_add_file, file);
-    }
-}
-#endif
-
 } // namespace Fm
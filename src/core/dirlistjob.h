@@ -3,10 +3,12 @@
 
 #include "../libfmqtglobals.h"
 #include <mutex>
+#include <QElapsedTimer>
 #include "job.h"
 #include "filepath.h"
 #include "gobjectptr.h"
 #include "fileinfo.h"
+#include "foldersnapshot.h"
 
 namespace Fm {
 
@@ -25,7 +27,10 @@ public:
         return files_;
     }
 
-    void setIncremental(bool set);
+    // In incremental mode, found files are delivered by filesFound() in batches of at most
+    // batchSize files, or whenever batchInterval milliseconds have passed since the last
+    // batch, and files() only contains those that have not been emitted yet (if any).
+    void setIncremental(bool set, size_t batchSize = 1000, int batchInterval = 250);
 
     bool incremental() const {
         return emit_files_found;
@@ -41,13 +46,35 @@ public:
         return dir_fi;
     }
 
+    // If set, the stamp of a local folder is taken before listing it, and the saved snapshot
+    // of the folder with the same stamp is loaded and delivered by snapshotLoaded() first.
+    void setLoadSnapshot(bool load) {
+        load_snapshot = load;
+    }
+
+    // the stamp of the folder before it was listed, if setLoadSnapshot() was used
+    bool dirStamp(FolderSnapshot::DirStamp& stamp) const {
+        std::lock_guard<std::mutex> lock{mutex_};
+        stamp = dir_stamp;
+        return has_dir_stamp;
+    }
+
 Q_SIGNALS:
+    // emitted from the job thread; should be connected with Qt::BlockingQueuedConnection
     void filesFound(FileInfoList& foundFiles);
 
+    // emitted from the job thread before the listing; should be connected with Qt::BlockingQueuedConnection
+    void snapshotLoaded(FileInfoList& files);
+
 protected:
 
     void exec() override;
 
+private:
+    void addFoundFile(FileInfoList& foundFiles, std::shared_ptr<FileInfo> fileInfo);
+
+    void listDir(const GFilePtr& dir_gfile, bool isFileSearch, FileInfoList& foundFiles);
+
 private:
     mutable std::mutex mutex_;
     FilePath dir_path;
@@ -56,8 +83,13 @@ private:
     FileInfoList files_;
     const std::shared_ptr<const HashSet> cutFilesHashSet_;
     bool emit_files_found;
-    // guint delay_add_files_handler;
-    // GSList* files_to_add;
+    const char* childAttribs_;
+    size_t batchSize_;
+    int batchInterval_;
+    QElapsedTimer batchTimer_;
+    FolderSnapshot::DirStamp dir_stamp;
+    bool load_snapshot;
+    bool has_dir_stamp;
 };
 
 } // namespace Fm
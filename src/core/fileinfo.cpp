@@ -15,7 +15,31 @@ const char defaultGFileInfoQueryAttribs[] = "standard::*,"
                                             "metadata::emblems,"
                                             METADATA_TRUST;
 
-FileInfo::FileInfo() {
+// NOTE: standard::icon is left out too because GIO sniffs the content type to get it.
+const char fastGFileInfoQueryAttribs[] = "standard::type,"
+                                         "standard::is-hidden,"
+                                         "standard::is-backup,"
+                                         "standard::is-symlink,"
+                                         "standard::name,"
+                                         "standard::display-name,"
+                                         "standard::edit-name,"
+                                         "standard::size,"
+                                         "standard::allocated-size,"
+                                         "standard::symlink-target,"
+                                         "standard::target-uri,"
+                                         "unix::*,"
+                                         "time::*,"
+                                         "access::*,"
+                                         "trash::deletion-date,"
+                                         "id::filesystem,"
+                                         "metadata::emblems,"
+                                         METADATA_TRUST;
+
+bool FileInfo::leanMode_ = false;
+const std::string FileInfo::emptyTarget_;
+
+FileInfo::FileInfo():
+    pathHash_{0} {
     // FIXME: initialize numeric data members
 }
 
@@ -26,11 +50,22 @@ FileInfo::FileInfo(const GFileInfoPtr& inf, const FilePath& filePath, const File
 FileInfo::~FileInfo() {
 }
 
+// static
+void FileInfo::setLeanMode(bool lean) {
+    leanMode_ = lean;
+}
+
 void FileInfo::setFromGFileInfo(const GObjectPtr<GFileInfo>& inf, const FilePath& filePath, const FilePath& parentDirPath) {
     inf_ = inf;
     filePath_ = filePath;
     if (filePath_ && filePath_.hasParent()) {
-        dirPath_ = filePath_.parent();
+        // share the parent dir path if possible, instead of keeping a GFile per file
+        if(parentDirPath && g_file_has_parent(filePath_.gfile().get(), parentDirPath.gfile().get())) {
+            dirPath_ = parentDirPath;
+        }
+        else {
+            dirPath_ = filePath_.parent();
+        }
     }
     else {
         dirPath_ = parentDirPath;
@@ -42,11 +77,20 @@ void FileInfo::setFromGFileInfo(const GObjectPtr<GFileInfo>& inf, const FilePath
     if (const char * name = g_file_info_get_name(inf.get()))
         name_ = name;
 
-    dispName_ = QString::fromUtf8(g_file_info_get_display_name(inf.get()));
+    // NOTE: The display name is stored even if it is the same as the name, since it is used
+    // (by reference) for every row when files are shown, sorted and filtered.
+    const char* dispName = g_file_info_get_display_name(inf.get());
+    if(!dispName) {
+        dispName = name_.c_str();
+    }
+    dispName_ = QString::fromUtf8(dispName);
 
     size_ = g_file_info_get_size(inf.get());
+    allocatedSize_ = g_file_info_get_attribute_uint64(inf.get(), G_FILE_ATTRIBUTE_STANDARD_ALLOCATED_SIZE);
 
-    tmp = g_file_info_get_content_type(inf.get());
+    // NOTE: the content type and the icon are not queried by fast listings (see fastGFileInfoQueryAttribs),
+    // so we don't use g_file_info_get_content_type() and g_file_info_get_icon(), which would complain.
+    tmp = g_file_info_get_attribute_string(inf.get(), G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE);
     if(tmp) {
         mimeType_ = MimeType::fromName(tmp);
     }
@@ -78,7 +122,7 @@ void FileInfo::setFromGFileInfo(const GObjectPtr<GFileInfo>& inf, const FilePath
         case G_FILE_TYPE_MOUNTABLE:
             break;
         case G_FILE_TYPE_SPECIAL:
-            if(mode_) {
+            if(mode_ || !tmp) {
                 break;
             }
             /* if it's a special file but it doesn't have UNIX mode, compose a fake one. */
@@ -147,13 +191,13 @@ void FileInfo::setFromGFileInfo(const GObjectPtr<GFileInfo>& inf, const FilePath
         if(uri) {
             if(g_str_has_prefix(uri, "file:///")) {
                 auto filename = CStrPtr{g_filename_from_uri(uri, nullptr, nullptr)};
-                target_ = filename.get();
+                target_ = std::make_shared<const std::string>(filename.get());
             }
             else {
-                target_ = uri;
+                target_ = std::make_shared<const std::string>(uri);
             }
             if(!mimeType_) {
-                mimeType_ = MimeType::guessFromFileName(target_.c_str());
+                mimeType_ = MimeType::guessFromFileName(target().c_str());
             }
         }
 
@@ -187,13 +231,13 @@ _file_is_symlink:
         if(uri) {
             if(g_str_has_prefix(uri, "file:///")) {
                 auto filename = CStrPtr{g_filename_from_uri(uri, nullptr, nullptr)};
-                target_ = filename.get();
+                target_ = std::make_shared<const std::string>(filename.get());
             }
             else {
-                target_ = uri;
+                target_ = std::make_shared<const std::string>(uri);
             }
             if(!mimeType_) {
-                mimeType_ = MimeType::guessFromFileName(target_.c_str());
+                mimeType_ = MimeType::guessFromFileName(target().c_str());
             }
         }
     /* Falls through. */
@@ -231,7 +275,7 @@ _file_is_symlink:
 
     if(!icon_) {
         /* try file-specific icon first */
-        gicon = g_file_info_get_icon(inf.get());
+        gicon = G_ICON(g_file_info_get_attribute_object(inf.get(), G_FILE_ATTRIBUTE_STANDARD_ICON));
         if(gicon) {
             icon_ = IconInfo::fromGIcon(gicon);
         }
@@ -270,10 +314,10 @@ _file_is_symlink:
     }
     isHidden_ = g_file_info_get_is_hidden(inf.get());
     // g_file_info_get_is_backup() does not cover ".bak" and ".old".
-    // NOTE: Here, dispName_ is not modified for desktop entries yet.
+    // NOTE: Here, the display name is not modified for desktop entries yet.
     isBackup_ = g_file_info_get_is_backup(inf.get())
-                || dispName_.endsWith(QLatin1String(".bak"))
-                || dispName_.endsWith(QLatin1String(".old"));
+                || g_str_has_suffix(dispName, ".bak")
+                || g_str_has_suffix(dispName, ".old");
     isNameChangeable_ = true; /* GVFS tends to ignore this attribute */
     isIconChangeable_ = isHiddenChangeable_ = false;
     if(g_file_info_has_attribute(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_RENAME)) {
@@ -293,7 +337,7 @@ _file_is_symlink:
                     CStrPtr uri{g_key_file_get_string(kf, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_URL, nullptr)};
                     if(uri) {
                         isShortcut_ = true;
-                        target_ = uri.get();
+                        target_ = std::make_shared<const std::string>(uri.get());
                     }
                 }
             }
@@ -317,6 +361,31 @@ _file_is_symlink:
     if(!icon_ && mimeType_)
         icon_ = mimeType_->icon();
 
+    /* to avoid GIO assertion warning: */
+    isTrusted_ = false;
+    if(g_file_info_get_attribute_type(inf.get(), METADATA_TRUST) == G_FILE_ATTRIBUTE_TYPE_STRING) {
+        if(const auto data = g_file_info_get_attribute_string(inf.get(), METADATA_TRUST)) {
+            isTrusted_ = (strcmp(data, "true") == 0);
+        }
+    }
+
+    // the base name and the hash of the path are used as keys in folders and models,
+    // so they are computed here once instead of making a GFile whenever they are needed
+    auto fullPath = path();
+    pathHash_ = fullPath.hash();
+    baseName_.reset();
+    if(filePath_) { // otherwise, the path is the child of dirPath_ named name_
+        auto baseName = fullPath.baseName();
+        if(baseName && name_ != baseName.get()) {
+            baseName_ = std::make_shared<const std::string>(baseName.get());
+        }
+    }
+
+    // everything needed is parsed now (see gFileInfo())
+    if(leanMode_) {
+        inf_.reset();
+    }
+
 #if 0
     GFile* _gf = nullptr;
     GFileAttributeInfoList* list;
@@ -357,14 +426,14 @@ bool FileInfo::isExecutableType() const {
         /* treat desktop entries as executables if
          they are native and have read permission */
         if(isNative() && (mode_ & (S_IRUSR|S_IRGRP|S_IROTH))) {
-            if(isShortcut() && !target_.empty()) {
+            if(isShortcut() && !target().empty()) {
                 /* handle shortcuts from desktop to menu entries:
                    first check for entries in /usr/share/applications and such
                    which may be considered as a safe desktop entry path
                    then check if that is a shortcut to a native file
                    otherwise it is a link to a file under menu:// */
-                if (!g_str_has_prefix(target_.c_str(), "/usr/share/")) {
-                    auto target = FilePath::fromPathStr(target_.c_str());
+                if (!g_str_has_prefix(target().c_str(), "/usr/share/")) {
+                    auto target = FilePath::fromPathStr(target().c_str());
                     bool is_native = target.isNative();
                     if (is_native) {
                         return true;
@@ -399,13 +468,7 @@ bool FileInfo::isExecutableType() const {
 
 bool FileInfo::isTrustable() const {
     if(isExecutableType()) {
-        /* to avoid GIO assertion warning: */
-        if(g_file_info_get_attribute_type(inf_.get(), METADATA_TRUST) == G_FILE_ATTRIBUTE_TYPE_STRING) {
-            if(const auto data = g_file_info_get_attribute_string(inf_.get(), METADATA_TRUST)) {
-                return (strcmp(data, "true") == 0);
-            }
-        }
-        return false;
+        return isTrusted_;
     }
     return true;
 }
@@ -417,18 +480,125 @@ void FileInfo::setTrustable(bool trust) const {
     GObjectPtr<GFileInfo> info {g_file_info_new()}; // used to set only this attribute
     if(trust) {
         g_file_info_set_attribute_string(info.get(), METADATA_TRUST, "true");
-        g_file_info_set_attribute_string(inf_.get(), METADATA_TRUST, "true");
+        if(inf_) {
+            g_file_info_set_attribute_string(inf_.get(), METADATA_TRUST, "true");
+        }
     }
     else {
         g_file_info_set_attribute(info.get(), METADATA_TRUST, G_FILE_ATTRIBUTE_TYPE_INVALID, nullptr);
-        g_file_info_set_attribute(inf_.get(), METADATA_TRUST, G_FILE_ATTRIBUTE_TYPE_INVALID, nullptr);
+        if(inf_) {
+            g_file_info_set_attribute(inf_.get(), METADATA_TRUST, G_FILE_ATTRIBUTE_TYPE_INVALID, nullptr);
+        }
     }
+    isTrusted_ = trust;
     g_file_set_attributes_from_info(path().gfile().get(),
                                     info.get(),
                                     G_FILE_QUERY_INFO_NONE,
                                     nullptr, nullptr);
 }
 
+QString FileInfo::editName() const {
+    if(inf_ && g_file_info_has_attribute(inf_.get(), G_FILE_ATTRIBUTE_STANDARD_EDIT_NAME)) {
+        if(const char* editName = g_file_info_get_edit_name(inf_.get())) {
+            return QString::fromUtf8(editName);
+        }
+    }
+    // the same as the edit names of local files (see gFileInfo())
+    CStrPtr editName{g_filename_display_name(name_.c_str())};
+    return QString::fromUtf8(editName.get());
+}
+
+GObjectPtr<GFileInfo> FileInfo::gFileInfo() const {
+    if(inf_) {
+        return inf_;
+    }
+    // Make a GFileInfo from which setFromGFileInfo() gets the same attributes. (The names,
+    // icons and targets of desktop entries and the icons of folders with a ".directory" file
+    // are not set here because setFromGFileInfo() reads them from the files anyway.)
+    GObjectPtr<GFileInfo> inf{g_file_info_new(), false};
+    GFileType type;
+    if(isShortcut_) {
+        type = G_FILE_TYPE_SHORTCUT;
+    }
+    else if(isMountable_) {
+        type = G_FILE_TYPE_MOUNTABLE;
+    }
+    else if(isDir()) {
+        type = G_FILE_TYPE_DIRECTORY;
+    }
+    else if(S_ISREG(mode_) || S_ISLNK(mode_)) {
+        type = G_FILE_TYPE_REGULAR;
+    }
+    else {
+        type = mode_ ? G_FILE_TYPE_SPECIAL : G_FILE_TYPE_UNKNOWN;
+    }
+    g_file_info_set_file_type(inf.get(), type);
+    g_file_info_set_name(inf.get(), name_.c_str());
+    g_file_info_set_display_name(inf.get(), displayName().toUtf8().constData());
+    // NOTE: the edit name is the display name of the file name, as with local files
+    CStrPtr editName{g_filename_display_name(name_.c_str())};
+    g_file_info_set_edit_name(inf.get(), editName.get());
+    g_file_info_set_size(inf.get(), size_);
+    g_file_info_set_attribute_uint64(inf.get(), G_FILE_ATTRIBUTE_STANDARD_ALLOCATED_SIZE, allocatedSize_);
+    g_file_info_set_attribute_string(inf.get(), G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE, mimeType_->name());
+    if(icon_ && icon_->gicon()) {
+        g_file_info_set_attribute_object(inf.get(), G_FILE_ATTRIBUTE_STANDARD_ICON, G_OBJECT(icon_->gicon().get()));
+    }
+    g_file_info_set_is_hidden(inf.get(), isHidden_);
+    g_file_info_set_is_backup(inf.get(), isBackup_);
+    if(S_ISLNK(mode_)) {
+        g_file_info_set_is_symlink(inf.get(), true);
+        g_file_info_set_symlink_target(inf.get(), target().c_str());
+    }
+    else if((isShortcut_ || isMountable_) && !target().empty()) {
+        g_file_info_set_attribute_string(inf.get(), G_FILE_ATTRIBUTE_STANDARD_TARGET_URI, target().c_str());
+    }
+
+    g_file_info_set_attribute_uint32(inf.get(), G_FILE_ATTRIBUTE_UNIX_MODE, mode_);
+    if(uid_ != uid_t(-1)) {
+        g_file_info_set_attribute_uint32(inf.get(), G_FILE_ATTRIBUTE_UNIX_UID, uid_);
+    }
+    if(gid_ != gid_t(-1)) {
+        g_file_info_set_attribute_uint32(inf.get(), G_FILE_ATTRIBUTE_UNIX_GID, gid_);
+    }
+    g_file_info_set_attribute_uint64(inf.get(), G_FILE_ATTRIBUTE_TIME_MODIFIED, mtime_);
+    g_file_info_set_attribute_uint64(inf.get(), G_FILE_ATTRIBUTE_TIME_ACCESS, atime_);
+    g_file_info_set_attribute_uint64(inf.get(), G_FILE_ATTRIBUTE_TIME_CHANGED, ctime_);
+    if(dtime_ != 0) {
+        GDateTime* dt = g_date_time_new_from_unix_local(dtime_);
+        CStrPtr date{g_date_time_format(dt, "%Y-%m-%dT%H:%M:%S")};
+        g_date_time_unref(dt);
+        g_file_info_set_attribute_string(inf.get(), G_FILE_ATTRIBUTE_TRASH_DELETION_DATE, date.get());
+    }
+    if(filesystemId_) {
+        g_file_info_set_attribute_string(inf.get(), G_FILE_ATTRIBUTE_ID_FILESYSTEM, filesystemId_);
+    }
+
+    g_file_info_set_attribute_boolean(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_READ, isAccessible_);
+    g_file_info_set_attribute_boolean(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_WRITE, isWritable_);
+    g_file_info_set_attribute_boolean(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_DELETE, isDeletable_);
+    g_file_info_set_attribute_boolean(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_RENAME, isNameChangeable_);
+    if(type == G_FILE_TYPE_DIRECTORY) {
+        g_file_info_set_attribute_boolean(inf.get(), G_FILE_ATTRIBUTE_FILESYSTEM_READONLY, isReadOnly_);
+    }
+
+    if(!emblems_.empty()) {
+        std::vector<const char*> emblemNames;
+        for(auto& emblem: emblems_) {
+            GIcon* gicon = emblem ? emblem->gicon().get() : nullptr;
+            if(gicon && G_IS_THEMED_ICON(gicon)) {
+                emblemNames.push_back(g_themed_icon_get_names(G_THEMED_ICON(gicon))[0]);
+            }
+        }
+        emblemNames.push_back(nullptr);
+        g_file_info_set_attribute_stringv(inf.get(), "metadata::emblems", const_cast<char**>(emblemNames.data()));
+    }
+    if(isTrusted_) {
+        g_file_info_set_attribute_string(inf.get(), METADATA_TRUST, "true");
+    }
+    return inf;
+}
+
 
 bool FileInfoList::isSameType() const {
     if(!empty()) {
@@ -55,6 +55,14 @@ public:
 
     virtual ~FileInfo();
 
+    // If enabled, the FileInfo objects created afterwards release their GFileInfo objects, which
+    // take several hundred bytes per file, once they are parsed (see gFileInfo()).
+    static void setLeanMode(bool lean);
+
+    static bool leanMode() {
+        return leanMode_;
+    }
+
     bool canSetHidden() const {
         return isHiddenChangeable_;
     }
@@ -106,7 +114,7 @@ public:
         return dtime_;
     }
     const std::string& target() const {
-        return target_;
+        return target_ ? *target_ : emptyTarget_;
     }
 
     bool isWritableDirectory() const {
@@ -181,7 +189,7 @@ public:
     }
 
     uint64_t realSize() const {
-        return blksize_ *blocks_;
+        return allocatedSize_;
     }
 
     uint64_t size() const {
@@ -200,6 +208,16 @@ public:
         return QString::fromUtf8(mimeType_ ? mimeType_->desc() : "");
     }
 
+    // the base name of path(), which is usually the same as name()
+    const std::string& baseName() const {
+        return baseName_ ? *baseName_ : name_;
+    }
+
+    // the same as path().hash(), without making a GFile
+    unsigned int pathHash() const {
+        return pathHash_;
+    }
+
     FilePath path() const {
         return filePath_ ? filePath_ : dirPath_ ? dirPath_.child(name_.c_str()) : FilePath::fromPathStr(name_.c_str());
     }
@@ -220,37 +238,52 @@ public:
 
     void setTrustable(bool trust) const;
 
-    GObjectPtr<GFileInfo> gFileInfo() const {
-        return inf_;
+    // The name of the file for renaming it, which is valid UTF-8 even if the name is not
+    // (see g_file_info_get_edit_name()). It does not need the GFileInfo object.
+    QString editName() const;
+
+    // Returns the GFileInfo object this object was created from. If it was released in lean mode,
+    // an equivalent one is made from the parsed attributes, without querying the file again.
+    // NOTE: In lean mode, a new object is made on each call, so the accessors above should be
+    // preferred; this is only meant for the rare users of all the attributes (like snapshots).
+    GObjectPtr<GFileInfo> gFileInfo() const;
+
+    // whether the GFileInfo object is kept (see setLeanMode())
+    bool hasGFileInfo() const {
+        return inf_ != nullptr;
     }
 
 private:
+    // NOTE: the members are ordered to avoid padding, since there may be millions of FileInfo objects
     GObjectPtr<GFileInfo> inf_;
     std::string name_;
     QString dispName_;
 
     FilePath filePath_;
-    FilePath dirPath_;
+    FilePath dirPath_; // shared by the files of a folder
 
-    mode_t mode_;
-    const char* filesystemId_;
-    uid_t uid_;
-    gid_t gid_;
+    const char* filesystemId_; // interned string
     uint64_t size_;
+    uint64_t allocatedSize_;
     quint64 mtime_;
     quint64 atime_;
     quint64 ctime_;
     quint64 dtime_;
 
-    uint64_t blksize_;
-    uint64_t blocks_;
-
     std::shared_ptr<const MimeType> mimeType_;
     std::shared_ptr<const IconInfo> icon_;
     std::forward_list<std::shared_ptr<const IconInfo>> emblems_;
 
-    std::string target_; /* target of shortcut or mountable. */
+    std::shared_ptr<const std::string> target_; /* target of shortcut or mountable, null if there is none */
+
+    std::weak_ptr<const HashSet> cutFilesHashSet_;
+
+    std::shared_ptr<const std::string> baseName_; // null if it is the same as name_
 
+    unsigned int pathHash_;
+    mode_t mode_;
+    uid_t uid_;
+    gid_t gid_;
     bool isShortcut_ : 1; /* TRUE if file is shortcut type */
     bool isMountable_ : 1; /* TRUE if file is mountable type */
     bool isAccessible_ : 1; /* TRUE if can be read by user */
@@ -262,9 +295,12 @@ private:
     bool isIconChangeable_ : 1; /* TRUE if icon can be changed */
     bool isHiddenChangeable_ : 1; /* TRUE if hidden can be changed */
     bool isReadOnly_ : 1; /* TRUE if host FS is R/O */
+    mutable bool isTrusted_ : 1; /* TRUE if metadata::trust is set */
 
-    std::weak_ptr<const HashSet> cutFilesHashSet_;
     // std::vector<std::tuple<int, void*, void(void*)>> extraData_;
+
+    static bool leanMode_;
+    static const std::string emptyTarget_;
 };
 
 
@@ -5,6 +5,10 @@ namespace Fm {
 
     extern const char defaultGFileInfoQueryAttribs[];
 
+    // same as defaultGFileInfoQueryAttribs but without content sniffing (the content type is
+    // guessed from the file name by FileInfo)
+    extern const char fastGFileInfoQueryAttribs[];
+
 } // namespace Fm
 
 #endif // FILEINFO_P_H
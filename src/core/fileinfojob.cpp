@@ -10,6 +10,7 @@ FileInfoJob::FileInfoJob(FilePathList paths, const std::shared_ptr<const HashSet
 }
 
 void FileInfoJob::exec() {
+    FilePath parentPath; // shared by the infos of the files in the same folder
     for(const auto& path: paths_) {
         if(isCancelled()) {
             break;
@@ -26,7 +27,10 @@ void FileInfoJob::exec() {
                 false
             };
             if(inf) {
-                auto fileInfoPtr = std::make_shared<FileInfo>(inf, path);
+                if(!parentPath || !g_file_has_parent(path.gfile().get(), parentPath.gfile().get())) {
+                    parentPath = path.parent();
+                }
+                auto fileInfoPtr = std::make_shared<FileInfo>(inf, path, parentPath);
 
                 // FIXME: this is not elegant
                 if(cutFilesHashSet_
@@ -0,0 +1,134 @@
+#include "filesortjob.h"
+#include "parallelfor.h"
+#include <algorithm>
+#include <numeric>
+
+namespace Fm {
+
+// the chunks of files sorted by each thread are not smaller than this
+static const size_t minChunkSize = 4096;
+
+FileSortJob::FileSortJob(const Options& options):
+    options_{options} {
+}
+
+FileSortJob::~FileSortJob() {
+}
+
+void FileSortJob::addFile(const std::shared_ptr<const FileInfo>& info, quint64 number, const QString& text) {
+    entries_.push_back(Entry{info, number, text, nullptr, nullptr, info->isDir(), info->isHidden()});
+}
+
+// the same order as ProxyFolderModel::lessThan(), with the original order of equal files
+bool FileSortJob::lessThan(int a, int b) const {
+    const Entry& left = entries_[a];
+    const Entry& right = entries_[b];
+    if(options_.folderFirst && left.isDir != right.isDir) {
+        return options_.order == Qt::AscendingOrder ? left.isDir : right.isDir;
+    }
+    if(options_.hiddenLast && left.isHidden != right.isHidden) {
+        return options_.order == Qt::AscendingOrder ? right.isHidden : left.isHidden;
+    }
+    int comp = 0;
+    switch(options_.key) {
+    case Key::Number:
+        if(left.number != right.number) {
+            return left.number < right.number;
+        }
+        break;
+    case Key::Text:
+        comp = left.textKey->compare(*right.textKey);
+        break;
+    default:
+        break;
+    }
+    if(comp == 0) {
+        comp = left.nameKey->compare(*right.nameKey);
+    }
+    return comp != 0 ? comp < 0 : a < b;
+}
+
+void FileSortJob::makeKeys(size_t chunk, size_t begin, size_t end) {
+    // NOTE: QCollator is not thread-safe, so each thread has its own one.
+    QCollator collator{options_.locale};
+    collator.setCaseSensitivity(options_.caseSensitivity);
+    collator.setNumericMode(options_.numericMode);
+    auto& nameKeys = nameKeys_[chunk];
+    auto& textKeys = textKeys_[chunk];
+    nameKeys.reserve(end - begin); // the entries point to the keys, which should not be moved
+    if(options_.key == Key::Text) {
+        textKeys.reserve(end - begin);
+    }
+    for(size_t i = begin; i < end; ++i) {
+        Entry& entry = entries_[i];
+        nameKeys.push_back(collator.sortKey(entry.info->displayName()));
+        entry.nameKey = &nameKeys.back();
+        if(options_.key == Key::Text) {
+            textKeys.push_back(collator.sortKey(entry.text));
+            entry.textKey = &textKeys.back();
+        }
+    }
+}
+
+void FileSortJob::exec() {
+    const size_t n = entries_.size();
+    const size_t n_chunks = parallelChunkCount(n, minChunkSize);
+    // the bounds of the chunks, and then those of the sorted runs to be merged
+    std::vector<size_t> bounds(n_chunks + 1);
+    for(size_t i = 0; i <= n_chunks; ++i) {
+        bounds[i] = n * i / n_chunks;
+    }
+
+    // make the collation keys
+    nameKeys_.resize(n_chunks);
+    textKeys_.resize(n_chunks);
+    parallelFor(n_chunks, [this, &bounds](size_t chunk) {
+        makeKeys(chunk, bounds[chunk], bounds[chunk + 1]);
+    });
+    if(isCancelled()) {
+        return;
+    }
+
+    // sort the chunks
+    std::vector<int> indexes(n);
+    std::iota(indexes.begin(), indexes.end(), 0);
+    auto less = [this](int a, int b) {
+        return lessThan(a, b);
+    };
+    parallelFor(n_chunks, [&indexes, &bounds, &less](size_t chunk) {
+        std::sort(indexes.begin() + bounds[chunk], indexes.begin() + bounds[chunk + 1], less);
+    });
+
+    // merge the sorted runs in pairs until there is only one run
+    std::vector<int> merged(n);
+    while(bounds.size() > 2) {
+        if(isCancelled()) {
+            return;
+        }
+        const size_t n_runs = bounds.size() - 1;
+        parallelFor((n_runs + 1) / 2, [&indexes, &merged, &bounds, &less, n_runs](size_t pair) {
+            size_t first = 2 * pair;
+            auto begin = indexes.begin() + bounds[first];
+            auto middle = indexes.begin() + bounds[first + 1];
+            auto out = merged.begin() + bounds[first];
+            if(first + 1 < n_runs) {
+                std::merge(begin, middle, middle, indexes.begin() + bounds[first + 2], out, less);
+            }
+            else { // the last run has no pair
+                std::copy(begin, middle, out);
+            }
+        });
+        indexes.swap(merged);
+        std::vector<size_t> runBounds;
+        for(size_t i = 0; i < bounds.size(); i += 2) {
+            runBounds.push_back(bounds[i]);
+        }
+        if(runBounds.back() != n) {
+            runBounds.push_back(n);
+        }
+        bounds.swap(runBounds);
+    }
+    sortedIndexes_ = std::move(indexes);
+}
+
+} // namespace Fm
@@ -0,0 +1,92 @@
+#ifndef FM2_FILESORTJOB_H
+#define FM2_FILESORTJOB_H
+
+#include "../libfmqtglobals.h"
+#include "job.h"
+#include "fileinfo.h"
+#include <QCollator>
+#include <QLocale>
+#include <QString>
+#include <vector>
+#include <memory>
+
+namespace Fm {
+
+// Sorts files in worker threads with a parallel merge sort. The sort keys of the files
+// (except for their collation keys, which are made by the job) are snapshotted when the
+// files are added, so the files may change meanwhile; the result is a permutation.
+// The order is the one of ProxyFolderModel::lessThan(), with the same options.
+class LIBFM_QT_API FileSortJob: public Job {
+    Q_OBJECT
+public:
+    enum class Key {
+        Name,   // display names only
+        Number, // numbers (like sizes or modification times), then display names
+        Text    // texts (like types or owners), then display names
+    };
+
+    struct Options {
+        Key key = Key::Name;
+        Qt::SortOrder order = Qt::AscendingOrder; // keeps folders first and hidden files last in both orders
+        bool folderFirst = true;
+        bool hiddenLast = false;
+        // the settings of the collator
+        QLocale locale;
+        Qt::CaseSensitivity caseSensitivity = Qt::CaseInsensitive;
+        bool numericMode = true;
+    };
+
+    explicit FileSortJob(const Options& options);
+
+    ~FileSortJob() override;
+
+    void addFile(const std::shared_ptr<const FileInfo>& info, quint64 number = 0, const QString& text = QString());
+
+    size_t fileCount() const {
+        return entries_.size();
+    }
+
+    const std::shared_ptr<const FileInfo>& file(size_t i) const {
+        return entries_[i].info;
+    }
+
+    // the collation key of the display name of the i-th file (after the job is finished)
+    const QCollatorSortKey& nameKey(size_t i) const {
+        return *entries_[i].nameKey;
+    }
+
+    // the indexes of the added files in ascending order (after the job is finished)
+    const std::vector<int>& sortedIndexes() const {
+        return sortedIndexes_;
+    }
+
+protected:
+    void exec() override;
+
+private:
+    struct Entry {
+        std::shared_ptr<const FileInfo> info;
+        quint64 number;
+        QString text;
+        const QCollatorSortKey* nameKey;
+        const QCollatorSortKey* textKey;
+        bool isDir;
+        bool isHidden;
+    };
+
+    bool lessThan(int a, int b) const;
+
+    void makeKeys(size_t chunk, size_t begin, size_t end);
+
+private:
+    Options options_;
+    std::vector<Entry> entries_;
+    // the collation keys made by each thread, which the entries point to
+    std::vector<std::vector<QCollatorSortKey>> nameKeys_;
+    std::vector<std::vector<QCollatorSortKey>> textKeys_;
+    std::vector<int> sortedIndexes_;
+};
+
+}
+
+#endif // FM2_FILESORTJOB_H
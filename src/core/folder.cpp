@@ -24,12 +24,18 @@
 #include "folder.h"
 #include <cstring>
 #include <cassert>
+#include <algorithm>
+#include <iterator>
+#include <QCoreApplication>
 #include <QTimer>
 #include <QDebug>
 
 #include "dirlistjob.h"
 #include "filesysteminfojob.h"
 #include "fileinfojob.h"
+#include "vfs/fm-file.h"
+#include "legacy/fm-config.h"
+#include "memoryusage_p.h"
 
 namespace Fm {
 
@@ -38,6 +44,29 @@ QString Folder::cutFilesDirPath_;
 QString Folder::lastCutFilesDirPath_;
 std::shared_ptr<const HashSet> Folder::cutFilesHashSet_;
 std::mutex Folder::mutex_;
+// NOTE: defined after mutex_, which is used by ~Folder()
+std::list<std::shared_ptr<Folder>> Folder::retainedFolders_;
+size_t Folder::maxRetainedFolders_ = 0;
+size_t Folder::maxRetainedMemory_ = 64 * 1024 * 1024;
+Folder::CacheStats Folder::cacheStats_;
+
+bool Folder::incrementalLoading_ = false;
+size_t Folder::incrementalBatchSize_ = 1000;
+int Folder::incrementalBatchInterval_ = 250;
+bool Folder::deferContentTest_ = false;
+int Folder::minUpdateDelay_ = 0;
+int Folder::maxUpdateDelay_ = 1000;
+bool Folder::snapshotCache_ = false;
+size_t Folder::snapshotMinFiles_ = 1000;
+
+// number of files whose content types are tested by each background info job
+static const size_t contentTestBatchSize = 256;
+
+// a rough estimate of the memory taken by a file, including its GFileInfo and strings
+static const size_t estimatedFileMemory = 512;
+
+// while a folder keeps changing, its update delay is doubled from this value (in ms)
+static const int hotUpdateDelayStep = 50;
 
 Folder::Folder():
     dirlist_job{nullptr},
@@ -46,6 +75,7 @@ Folder::Folder():
     /* for file monitor */
     has_idle_reload_handler{false},
     has_idle_update_handler{false},
+    update_delay{minUpdateDelay_},
     pending_change_notify{false},
     filesystem_info_pending{false},
     wants_incremental{false},
@@ -54,7 +84,9 @@ Folder::Folder():
     fs_total_size{0},
     fs_free_size{0},
     has_fs_info{false},
-    defer_content_test{false} {
+    defer_content_test{false},
+    has_dir_stamp{false},
+    snapshot_valid{false} {
 
     connect(volumeManager_.get(), &VolumeManager::mountAdded, this, &Folder::onMountAdded);
     connect(volumeManager_.get(), &VolumeManager::mountRemoved, this, &Folder::onMountRemoved);
@@ -95,23 +127,173 @@ Folder::~Folder() {
 
 // static
 std::shared_ptr<Folder> Folder::fromPath(const FilePath& path) {
+    // NOTE: the evicted folders should be freed after the mutex is unlocked (see ~Folder())
+    std::vector<std::shared_ptr<Folder>> evicted;
     std::lock_guard<std::mutex> lock{mutex_};
     auto it = cache_.find(path);
     if(it != cache_.end()) {
         auto folder = it->second.lock();
         if(folder) {
+            ++cacheStats_.hits;
+            retainFolder(folder, evicted);
             return folder;
         }
         else { // FIXME: is this possible?
             cache_.erase(it);
         }
     }
+    ++cacheStats_.misses;
     auto folder = std::make_shared<Folder>(path);
     folder->reload();
     cache_.emplace(path, folder);
+    retainFolder(folder, evicted);
     return folder;
 }
 
+// static
+// Moves the folder to the front of the retained folders, and drops the least recently used ones
+// that exceed the limits. The mutex should be locked.
+void Folder::retainFolder(const std::shared_ptr<Folder>& folder, std::vector<std::shared_ptr<Folder>>& evicted) {
+    if(maxRetainedFolders_ == 0) {
+        return;
+    }
+    auto it = std::find(retainedFolders_.begin(), retainedFolders_.end(), folder);
+    if(it != retainedFolders_.end()) {
+        retainedFolders_.splice(retainedFolders_.begin(), retainedFolders_, it);
+    }
+    else {
+        retainedFolders_.push_front(folder);
+    }
+
+    // the most recently used folder is always kept
+    size_t count = 0;
+    size_t memory = 0;
+    for(it = retainedFolders_.begin(); it != retainedFolders_.end();) {
+        ++count;
+        memory += (*it)->memoryEstimate();
+        if(count > 1 && (count > maxRetainedFolders_ || memory > maxRetainedMemory_)) {
+            evicted.push_back(std::move(*it));
+            it = retainedFolders_.erase(it);
+            ++cacheStats_.evictions;
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+// the retained folders should be freed before the application object
+static void releaseRetainedFolders() {
+    Folder::setRetention(0);
+}
+
+// static
+void Folder::setRetention(size_t maxFolders, size_t maxMemory) {
+    static bool postRoutineAdded = false;
+    if(maxFolders > 0 && !postRoutineAdded && QCoreApplication::instance()) {
+        qAddPostRoutine(releaseRetainedFolders);
+        postRoutineAdded = true;
+    }
+    std::list<std::shared_ptr<Folder>> evicted; // freed after the mutex is unlocked
+    std::lock_guard<std::mutex> lock{mutex_};
+    maxRetainedFolders_ = maxFolders;
+    maxRetainedMemory_ = maxMemory;
+    while(retainedFolders_.size() > maxRetainedFolders_) {
+        evicted.splice(evicted.begin(), retainedFolders_, std::prev(retainedFolders_.end()));
+        ++cacheStats_.evictions;
+    }
+}
+
+// static
+Folder::CacheStats Folder::cacheStats() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    CacheStats stats = cacheStats_;
+    stats.retained = retainedFolders_.size();
+    return stats;
+}
+
+static size_t gFileInfoMemory(GFileInfo* inf) {
+    // NOTE: the GFileInfo internals are private; each attribute takes an id and a GFileAttributeValue
+    const size_t attributeSize = 4 * sizeof(void*);
+    size_t size = 8 * sizeof(void*); // the instance with its attribute array
+    CStrArrayPtr attrs{g_file_info_list_attributes(inf, nullptr)};
+    for(char** attr = attrs.get(); attr && *attr; ++attr) {
+        size += attributeSize;
+        switch(g_file_info_get_attribute_type(inf, *attr)) {
+        case G_FILE_ATTRIBUTE_TYPE_STRING:
+            size += strlen(g_file_info_get_attribute_string(inf, *attr)) + 1;
+            break;
+        case G_FILE_ATTRIBUTE_TYPE_BYTE_STRING:
+            size += strlen(g_file_info_get_attribute_byte_string(inf, *attr)) + 1;
+            break;
+        case G_FILE_ATTRIBUTE_TYPE_STRINGV:
+            for(char** str = g_file_info_get_attribute_stringv(inf, *attr); str && *str; ++str) {
+                size += sizeof(char*) + strlen(*str) + 1;
+            }
+            break;
+        default: // the objects (icons) are shared
+            break;
+        }
+    }
+    return size;
+}
+
+void Folder::addMemoryUsage(MemoryUsage& usage, std::unordered_set<const void*>& sharedInfos) const {
+    ++usage.folders;
+    usage.files += files_.size();
+    usage.fileInfos += sizeof(Folder) + files_.bucket_count() * sizeof(void*);
+    for(const auto& item: files_) {
+        auto& file = item.second;
+        // the shared_ptr control block and the node of files_ are included
+        usage.fileInfos += sizeof(FileInfo) + 2 * sizeof(void*) + sizeof(item) + stringMemory(item.first)
+                           + stringMemory(file->name()) + stringMemory(file->target());
+        for(auto& emblem: file->emblems()) {
+            usage.fileInfos += sizeof(void*) + sizeof(emblem);
+        }
+        usage.displayNames += stringMemory(file->displayName());
+        if(file->hasGFileInfo()) { // not in lean mode
+            usage.gFileInfos += gFileInfoMemory(file->gFileInfo().get());
+        }
+        if(file->mimeType() && sharedInfos.insert(file->mimeType().get()).second) {
+            usage.sharedInfos += sizeof(MimeType);
+        }
+        if(file->icon() && sharedInfos.insert(file->icon().get()).second) {
+            usage.sharedInfos += sizeof(IconInfo);
+        }
+    }
+}
+
+Folder::MemoryUsage Folder::memoryUsage() const {
+    MemoryUsage usage;
+    std::unordered_set<const void*> sharedInfos;
+    addMemoryUsage(usage, sharedInfos);
+    return usage;
+}
+
+// static
+Folder::MemoryUsage Folder::totalMemoryUsage() {
+    std::vector<std::shared_ptr<Folder>> folders;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        for(auto& item: cache_) {
+            if(auto folder = item.second.lock()) {
+                folders.push_back(std::move(folder));
+            }
+        }
+    }
+    // the shared infos are counted once for all folders
+    MemoryUsage usage;
+    std::unordered_set<const void*> sharedInfos;
+    for(auto& folder: folders) {
+        folder->addMemoryUsage(usage, sharedInfos);
+    }
+    return usage;
+}
+
+size_t Folder::memoryEstimate() const {
+    return sizeof(Folder) + files_.size() * estimatedFileMemory;
+}
+
 // static
 // Checks if this is the path of a folder in use.
 std::shared_ptr<Folder> Folder::findByPath(const FilePath& path) {
@@ -126,6 +308,33 @@ std::shared_ptr<Folder> Folder::findByPath(const FilePath& path) {
     return nullptr;
 }
 
+// static
+void Folder::setIncrementalLoading(bool incremental, size_t batchSize, int batchInterval) {
+    incrementalLoading_ = incremental;
+    incrementalBatchSize_ = batchSize;
+    incrementalBatchInterval_ = batchInterval;
+}
+
+// static
+void Folder::setDeferContentTest(bool defer) {
+    deferContentTest_ = defer;
+    if(fm_config) {
+        fm_config->defer_content_test = deferContentTest_;
+    }
+}
+
+// static
+void Folder::setUpdateDelay(int minDelay, int maxDelay) {
+    minUpdateDelay_ = std::max(minDelay, 0);
+    maxUpdateDelay_ = std::max(maxDelay, minUpdateDelay_);
+}
+
+// static
+void Folder::setSnapshotCache(bool enable, size_t minFiles) {
+    snapshotCache_ = enable;
+    snapshotMinFiles_ = minFiles;
+}
+
 bool Folder::makeDirectory(const char* /*name*/, GError** /*error*/) {
     // TODO:
     // FIXME: what the API is used for in the original libfm C API?
@@ -244,14 +453,15 @@ void Folder::onFileInfoFinished() {
             dirInfo_ = info;
         }
         else {
-            auto it = files_.find(info->path().baseName().get());
+            auto it = files_.find(info->baseName());
             if(it != files_.end()) { // the file already exists, update
                 files_to_update.push_back(std::make_pair(it->second, info));
+                it->second = info;
             }
             else { // newly added
                 files_to_add.push_back(info);
+                files_.emplace(info->baseName(), info);
             }
-            files_[info->path().baseName().get()] = info;
         }
     }
     if(!files_to_add.empty()) {
@@ -264,7 +474,10 @@ void Folder::onFileInfoFinished() {
 
     // process the changes accumulated during this info job
     if(filesystem_info_pending // means a pending change; see "onFileSystemInfoFinished()"
-       || !paths_to_update.empty() || !paths_to_add.empty() || !paths_to_del.empty()) {
+       || !pending_changes.empty()) {
+        QTimer::singleShot(update_delay, this, &Folder::processPendingChanges);
+    }
+    else if(!paths_to_sniff.empty()) { // content tests are not delayed
         QTimer::singleShot(0, this, &Folder::processPendingChanges);
     }
     // there's no pending change at the moment; let the next one be processed
@@ -284,14 +497,59 @@ void Folder::processPendingChanges() {
         return;
     }
 
+    // Adapt the delay to the rate of changes: while new changes keep coming soon after
+    // the previous update, the delay is doubled up to maxUpdateDelay_, so that a file
+    // being written continuously is not queried again and again. Once the folder calms
+    // down, the delay returns to minUpdateDelay_.
+    if(!pending_changes.empty()) {
+        if(last_update_time.isValid() && last_update_time.elapsed() < update_delay + 2 * hotUpdateDelayStep) {
+            update_delay = qBound(minUpdateDelay_, std::max(2 * update_delay, hotUpdateDelayStep), maxUpdateDelay_);
+        }
+        else {
+            update_delay = minUpdateDelay_;
+        }
+        last_update_time.start();
+    }
+
+    // collect the files to be (re)queried, and process deletions
+    FilePathList paths;
+    FileInfoList deleted_files;
+    for(auto it = pending_changes.begin(); it != pending_changes.end();) {
+        auto& change = it->second;
+        if(change & (PENDING_ADD | PENDING_UPDATE)) {
+            paths.push_back(it->first);
+            change &= ~(PENDING_ADD | PENDING_UPDATE);
+        }
+        if(change & PENDING_DEL) {
+            auto name = it->first.baseName();
+            auto file_it = files_.find(name.get());
+            // NOTE: If the file is not found, it may be added by an info job in progress,
+            // so its deletion is kept in the queue.
+            if(file_it != files_.end()) {
+                deleted_files.push_back(file_it->second);
+                files_.erase(file_it);
+                change &= ~PENDING_DEL;
+            }
+        }
+        if(change == 0) {
+            it = pending_changes.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+
     FileInfoJob* info_job = nullptr;
-    if(!paths_to_update.empty() || !paths_to_add.empty()) {
-        FilePathList paths;
-        paths.insert(paths.end(), paths_to_add.cbegin(), paths_to_add.cend());
-        paths.insert(paths.end(), paths_to_update.cbegin(), paths_to_update.cend());
-        info_job = new FileInfoJob{paths, hasCutFiles() ? cutFilesHashSet_ : nullptr};
-        paths_to_update.clear();
-        paths_to_add.clear();
+    if(!paths.empty()) {
+        info_job = new FileInfoJob{std::move(paths), hasCutFiles() ? cutFilesHashSet_ : nullptr};
+    }
+    else if(!paths_to_sniff.empty()) {
+        // when there is no real change, test the content types of some deferred files
+        // (the info job will update them with the content types found by GIO)
+        auto n_paths = std::min(paths_to_sniff.size(), contentTestBatchSize);
+        FilePathList sniffed_paths(paths_to_sniff.end() - n_paths, paths_to_sniff.end());
+        paths_to_sniff.resize(paths_to_sniff.size() - n_paths);
+        info_job = new FileInfoJob{std::move(sniffed_paths), hasCutFiles() ? cutFilesHashSet_ : nullptr};
     }
     else {
         // let the next pending changes be processed; see "onFileInfoFinished()"
@@ -313,22 +571,6 @@ void Folder::processPendingChanges() {
 #endif
     }
 
-    // process deletion
-    FileInfoList deleted_files;
-    auto path_it = paths_to_del.begin();
-    while(path_it != paths_to_del.end()) {
-        const auto& path = *path_it;
-        auto name = path.baseName();
-        auto it = files_.find(name.get());
-        if(it != files_.end()) {
-            deleted_files.push_back(it->second);
-            files_.erase(it);
-            path_it = paths_to_del.erase(path_it);
-        }
-        else {
-            ++path_it;
-        }
-    }
     if(!deleted_files.empty()) {
         Q_EMIT filesRemoved(deleted_files);
         Q_EMIT contentChanged();
@@ -349,9 +591,16 @@ void Folder::processPendingChanges() {
 
 /* should be called only with G_LOCK(lists) on! */
 void Folder::queueUpdate() {
-    // qDebug() << "queue_update:" << !has_idle_handler << paths_to_add.size() << paths_to_update.size() << paths_to_del.size();
+    // qDebug() << "queue_update:" << !has_idle_update_handler << pending_changes.size();
     if(!has_idle_update_handler) {
-        QTimer::singleShot(0, this, &Folder::processPendingChanges);
+        // The delay is only adapted when the changes are processed, so the delay of a busy
+        // period would be kept for the first change after it, even much later; return to
+        // the shortest delay if the folder has been calm since the last update.
+        if(!last_update_time.isValid() || last_update_time.elapsed() >= update_delay + 2 * hotUpdateDelayStep) {
+            update_delay = minUpdateDelay_;
+        }
+        // changes coming during the delay are merged into the same update
+        QTimer::singleShot(update_delay, this, &Folder::processPendingChanges);
         has_idle_update_handler = true;
     }
 }
@@ -361,65 +610,51 @@ void Folder::queueUpdate() {
    the currently detected files (namely, "files_") should not be taken into account
    because they might be changed soon due to a previous call to queueUpdate(). */
 
+/* NOTE: The pending changes of each file are merged into one entry of "pending_changes",
+   so that handling an event does not depend on the number of pending changes. */
+
 /* returns true if reference was taken from path */
 bool Folder::eventFileAdded(const FilePath &path) {
-    bool added = true;
     // G_LOCK(lists);
-    if(std::find(paths_to_del.cbegin(), paths_to_del.cend(), path) != paths_to_del.cend()) {
+    auto& change = pending_changes[path];
+    if(change & PENDING_DEL) {
         // if the file was going to be deleted, its addition means an update,
         // so remove it from the deletion queue and add it to the update queue
-        paths_to_del.erase(std::remove(paths_to_del.begin(), paths_to_del.end(), path), paths_to_del.cend());
-        if(std::find(paths_to_update.cbegin(), paths_to_update.cend(), path) == paths_to_update.cend()) {
-            paths_to_update.push_back(path);
-        }
+        change = (change & ~PENDING_DEL) | PENDING_UPDATE;
     }
-    else if(std::find(paths_to_add.cbegin(), paths_to_add.cend(), path) == paths_to_add.cend()) {
-        paths_to_add.push_back(path);
+    else if(!(change & PENDING_ADD)) {
+        change |= PENDING_ADD;
     }
     else { // file already queued for adding, don't duplicate
-        added = false;
-    }
-
-    if(added) {
-        queueUpdate();
+        return false;
     }
+    queueUpdate();
     // G_UNLOCK(lists);
-    return added;
+    return true;
 }
 
 bool Folder::eventFileChanged(const FilePath &path) {
-    bool added;
     // G_LOCK(lists);
-    if(std::find(paths_to_update.cbegin(), paths_to_update.cend(), path) == paths_to_update.cend()
-       && std::find(paths_to_add.cbegin(), paths_to_add.cend(), path) == paths_to_add.cend()) {
-        paths_to_update.push_back(path);
-        added = true;
-        queueUpdate();
-    }
-    else {
-        added = false;
+    auto& change = pending_changes[path];
+    if(change & (PENDING_ADD | PENDING_UPDATE)) { // the file info will be queried anyway
+        return false;
     }
+    change |= PENDING_UPDATE;
+    queueUpdate();
     // G_UNLOCK(lists);
-    return added;
+    return true;
 }
 
 void Folder::eventFileDeleted(const FilePath& path) {
-    bool deleted = true;
     // qDebug() << "delete " << path.baseName().get();
     // G_LOCK(lists);
     /* WARNING: If the file is in the addition queue, we shouldn not remove it from that queue
        and ignore its deletion because it may have been added by the directory list job, in
        which case, ignoring an addition-deletion sequence would result in a nonexistent file. */
-    if(std::find(paths_to_del.cbegin(), paths_to_del.cend(), path) == paths_to_del.cend()) {
-        paths_to_del.push_back(path);
+    auto& change = pending_changes[path];
+    if(!(change & PENDING_DEL)) {
         // the update queue can be cancelled for a file that is going to be deleted
-        paths_to_update.erase(std::remove(paths_to_update.begin(), paths_to_update.end(), path), paths_to_update.cend());
-    }
-    else {
-        deleted = false;
-    }
-
-    if(deleted) {
+        change = (change & ~PENDING_UPDATE) | PENDING_DEL;
         queueUpdate();
     }
     // G_UNLOCK(lists);
@@ -447,10 +682,7 @@ void Folder::onDirChanged(GFileMonitorEvent evt) {
     case G_FILE_MONITOR_EVENT_CHANGED: {
         std::lock_guard<std::mutex> lock{mutex_};
         pending_change_notify = true;
-        if(std::find(paths_to_update.cbegin(), paths_to_update.cend(), dirPath_) != paths_to_update.cend()) {
-            paths_to_update.push_back(dirPath_);
-            queueUpdate();
-        }
+        eventFileChanged(dirPath_); // update the info of the folder itself
         /* g_debug("folder is changed"); */
         break;
     }
@@ -531,56 +763,81 @@ void Folder::updateCutFiles() {
     auto tmp = files();
     std::vector<FileInfoPair> cut_files_to_update;
     for(auto& file : tmp) {
-        auto fileInfoPtr = std::make_shared<FileInfo>(file->gFileInfo(), file->path());
+        // NOTE: the file info is copied instead of being made again from its GFileInfo,
+        // which may have been released (see FileInfo::setLeanMode()).
+        auto fileInfoPtr = std::make_shared<FileInfo>(*file);
         if(cutFilesHashSet_
-           && cutFilesHashSet_->count(file->path().hash())) {
+           && cutFilesHashSet_->count(file->pathHash())) {
             fileInfoPtr->bindCutFiles(cutFilesHashSet_);
         }
-        auto it = files_.find(file->path().baseName().get());
+        else {
+            fileInfoPtr->bindCutFiles(nullptr);
+        }
+        auto it = files_.find(file->baseName());
         if(it != files_.end()) {
             cut_files_to_update.push_back(std::make_pair(it->second, fileInfoPtr));
+            it->second = fileInfoPtr;
+        }
+        else {
+            files_.emplace(fileInfoPtr->baseName(), fileInfoPtr);
         }
-        files_[fileInfoPtr->path().baseName().get()] = fileInfoPtr;
     }
     if(!cut_files_to_update.empty()) {
         Q_EMIT cutFilesChanged(cut_files_to_update);
     }
 }
 
-void Folder::onDirListFinished() {
-    DirListJob* job = static_cast<DirListJob*>(sender());
-    if(job->isCancelled()) { // this is a cancelled job, ignore!
-        if(job == dirlist_job) {
-            dirlist_job = nullptr;
-            Q_EMIT finishLoading(); // this was the last job until now
-        }
-        return;
-    }
-    dirInfo_ = job->dirInfo();
+// checks whether a listed file has not changed since its info was saved in the snapshot
+static bool isSameFile(const FileInfo& cached, const FileInfo& listed) {
+    return cached.mtime() == listed.mtime()
+           && cached.ctime() == listed.ctime() // changed by chmod, chown, etc. too
+           && cached.size() == listed.size()
+           && cached.mode() == listed.mode()
+           && cached.uid() == listed.uid()
+           && cached.gid() == listed.gid()
+           && cached.isCut() == listed.isCut()
+           && cached.target() == listed.target()
+           && cached.displayName() == listed.displayName();
+}
 
+// merges the files found by the dir list job into files_
+void Folder::addListedFiles(const FileInfoList& infos) {
     FileInfoList files_to_add;
     std::vector<FileInfoPair> files_to_update;
-    const auto& infos = job->files();
 
     // with "search://", there is no update for infos and all of them should be added
     if(strcmp(dirPath_.uriScheme().get(), "search") == 0) {
         files_to_add = infos;
         for(auto& file: files_to_add) {
-            files_[file->path().baseName().get()] = file;
+            files_[file->baseName()] = file;
         }
     }
     else {
         auto info_it = infos.cbegin();
         for(; info_it != infos.cend(); ++info_it) {
             const auto& info = *info_it;
-            auto it = files_.find(info->path().baseName().get());
+            const auto& name = info->baseName();
+            auto it = files_.find(name);
             if(it != files_.end()) {
+                // reconcile the files loaded from the snapshot (see loadSnapshot())
+                auto cached = unconfirmed_files.find(name);
+                if(cached != unconfirmed_files.end()) {
+                    bool unchanged = cached->second == it->second && isSameFile(*it->second, *info);
+                    unconfirmed_files.erase(cached);
+                    if(unchanged) {
+                        // keep the cached info, whose content type may have been tested already
+                        continue;
+                    }
+                    snapshot_valid = false;
+                }
                 files_to_update.push_back(std::make_pair(it->second, info));
+                it->second = info;
             }
             else {
+                snapshot_valid = false;
                 files_to_add.push_back(info);
+                files_.emplace(name, info);
             }
-            files_[info->path().baseName().get()] = info;
         }
     }
 
@@ -591,6 +848,97 @@ void Folder::onDirListFinished() {
         Q_EMIT filesChanged(files_to_update);
     }
 
+    // the content types were only guessed from the file names; test the ambiguous ones later
+    if(defer_content_test) {
+        bool queued = false;
+        auto queueSniff = [&](const FileInfoPtr& info) {
+            if(!info->isDir() && info->isUnknownType()) {
+                paths_to_sniff.push_back(info->path());
+                queued = true;
+            }
+        };
+        for(auto& info: files_to_add) {
+            queueSniff(info);
+        }
+        for(auto& change: files_to_update) {
+            queueSniff(change.second);
+        }
+        if(queued) {
+            std::lock_guard<std::mutex> lock{mutex_};
+            queueUpdate();
+        }
+    }
+}
+
+void Folder::onDirListFilesFound(FileInfoList& files) {
+    DirListJob* job = static_cast<DirListJob*>(sender());
+    if(job != dirlist_job || job->isCancelled()) { // the job is being replaced by a newer one
+        return;
+    }
+    if(!dirInfo_) { // we may want the dir info while the folder is still being loaded
+        dirInfo_ = job->dirInfo();
+    }
+    addListedFiles(files);
+    Q_EMIT contentChanged();
+}
+
+// shows the files of the last listing while the folder is being listed again
+void Folder::onDirListSnapshotLoaded(FileInfoList& files) {
+    DirListJob* job = static_cast<DirListJob*>(sender());
+    if(job != dirlist_job || job->isCancelled() || !files_.empty()) {
+        return;
+    }
+    for(auto& file: files) {
+        files_[file->baseName()] = file;
+        unconfirmed_files[file->baseName()] = file;
+    }
+    snapshot_valid = true;
+    Q_EMIT filesAdded(files);
+    Q_EMIT contentChanged();
+}
+
+void Folder::onDirListFinished() {
+    DirListJob* job = static_cast<DirListJob*>(sender());
+    if(job->isCancelled()) { // this is a cancelled job, ignore!
+        if(job == dirlist_job) {
+            dirlist_job = nullptr;
+            Q_EMIT finishLoading(); // this was the last job until now
+        }
+        return;
+    }
+    dirInfo_ = job->dirInfo();
+    has_dir_stamp = job->dirStamp(dir_stamp);
+
+    // in incremental mode, only the files that were not emitted in batches are left here
+    addListedFiles(job->files());
+
+    // the files loaded from the snapshot but not listed were removed
+    if(!unconfirmed_files.empty()) {
+        FileInfoList files_to_remove;
+        for(auto& file: unconfirmed_files) {
+            auto it = files_.find(file.first);
+            if(it != files_.end() && it->second == file.second) {
+                files_to_remove.push_back(it->second);
+                files_.erase(it);
+            }
+        }
+        unconfirmed_files.clear();
+        snapshot_valid = false;
+        if(!files_to_remove.empty()) {
+            Q_EMIT filesRemoved(files_to_remove);
+        }
+    }
+
+    // save a new snapshot if the loaded one was outdated
+    if(has_dir_stamp && !snapshot_valid) {
+        if(files_.size() >= snapshotMinFiles_) {
+            FolderSnapshot::save(dirPath_, dir_stamp, files());
+        }
+        else {
+            FolderSnapshot::remove(dirPath_);
+        }
+    }
+
 #if 0
     if(dirlist_job->isCancelled() && !wants_incremental) {
         GList* l;
@@ -653,21 +1001,6 @@ void Folder::onDirListFinished() {
 #if 0
 
 
-void on_dirlist_job_files_found(FmDirListJob* job, GSList* files, gpointer user_data) {
-    FmFolder* folder = FM_FOLDER(user_data);
-    GSList* l;
-    for(l = files; l; l = l->next) {
-        FmFileInfo* file = FM_FILE_INFO(l->data);
-        fm_file_info_list_push_tail(files, file);
-    }
-    if(G_UNLIKELY(!dir_fi && job->dir_fi))
-        /* we may want info while folder is still loading */
-    {
-        dir_fi = fm_file_info_ref(job->dir_fi);
-    }
-    g_signal_emit(folder, signals[FILES_ADDED], 0, files);
-}
-
 ErrorAction on_dirlist_job_error(FmDirListJob* job, GError* err, FmJobErrorSeverity severity, FmFolder* folder) {
     guint ret;
     /* it's possible that some signal handlers tries to free the folder
@@ -678,17 +1011,6 @@ ErrorAction on_dirlist_job_error(FmDirListJob* job, GError* err, FmJobErrorSever
     return ret;
 }
 
-void free_dirlist_job(FmFolder* folder) {
-    if(wants_incremental) {
-        g_signal_handlers_disconnect_by_func(dirlist_job, on_dirlist_job_files_found, folder);
-    }
-    g_signal_handlers_disconnect_by_func(dirlist_job, on_dirlist_job_finished, folder);
-    g_signal_handlers_disconnect_by_func(dirlist_job, on_dirlist_job_error, folder);
-    fm_job_cancel(FM_JOB(dirlist_job));
-    g_object_unref(dirlist_job);
-    dirlist_job = nullptr;
-}
-
 #endif
 
 
@@ -708,9 +1030,8 @@ void Folder::reload() {
        listing job is finished, a duplicate may be created in the folder */
     if(has_idle_update_handler) {
         // FIXME: cancel the idle handler
-        paths_to_add.clear();
-        paths_to_update.clear();
-        paths_to_del.clear();
+        pending_changes.clear();
+        paths_to_sniff.clear();
 
         // cancel any file info job in progress.
         for(auto job: fileinfoJobs_) {
@@ -758,21 +1079,31 @@ void Folder::reload() {
 
     Q_EMIT contentChanged();
 
+    // The snapshot is loaded by the dir list job, and its files are added when the event loop
+    // is reached, after the users of the folder are connected to it (see fromPath()).
+    unconfirmed_files.clear();
+    snapshot_valid = false;
+    has_dir_stamp = false;
+
     /* run a new dir listing job */
-    // FIXME:
-    // defer_content_test = fm_config->defer_content_test;
+    // NOTE: content tests are only deferred for local folders because testing
+    // remote files later would need one more round trip per file.
+    defer_content_test = (fm_config ? fm_config->defer_content_test : deferContentTest_) && dirPath_.isNative();
     dirlist_job = new DirListJob(dirPath_, defer_content_test ? DirListJob::FAST : DirListJob::DETAILED,
                                  hasCutFiles() ? cutFilesHashSet_ : nullptr);
     dirlist_job->setAutoDelete(true);
     connect(dirlist_job, &DirListJob::error, this, &Folder::error, Qt::BlockingQueuedConnection);
     connect(dirlist_job, &DirListJob::finished, this, &Folder::onDirListFinished, Qt::BlockingQueuedConnection);
+    if(snapshotCache_ && dirPath_.isNative()) {
+        connect(dirlist_job, &DirListJob::snapshotLoaded, this, &Folder::onDirListSnapshotLoaded, Qt::BlockingQueuedConnection);
+        dirlist_job->setLoadSnapshot(true);
+    }
 
-#if 0
+    wants_incremental = incrementalLoading_ || fm_file_wants_incremental(dirPath_.gfile().get());
     if(wants_incremental) {
-        g_signal_connect(dirlist_job, "files-found", G_CALLBACK(on_dirlist_job_files_found), folder);
+        connect(dirlist_job, &DirListJob::filesFound, this, &Folder::onDirListFilesFound, Qt::BlockingQueuedConnection);
+        dirlist_job->setIncremental(true, incrementalBatchSize_, incrementalBatchInterval_);
     }
-    fm_dir_list_job_set_incremental(dirlist_job, wants_incremental);
-#endif
 
     dirlist_job->runAsync();
 
@@ -24,18 +24,22 @@
 #include <cstdint>
 #include <memory>
 #include <vector>
+#include <list>
 #include <unordered_map>
+#include <unordered_set>
 #include <mutex>
 #include <functional>
 
 #include <QObject>
 #include <QtGlobal>
+#include <QElapsedTimer>
 #include "../libfmqtglobals.h"
 
 #include "gioptrs.h"
 #include "fileinfo.h"
 #include "job.h"
 #include "volumemanager.h"
+#include "foldersnapshot.h"
 
 namespace Fm {
 
@@ -58,6 +62,73 @@ public:
 
     static std::shared_ptr<Folder> findByPath(const FilePath& path);
 
+    // Keeps up to maxFolders recently used folders loaded, with their file monitors, even after
+    // they are not used anymore, as long as their files take less than maxMemory bytes (roughly
+    // estimated). Going back to such a folder does not need to list it again.
+    // The retention is disabled by default (maxFolders = 0).
+    static void setRetention(size_t maxFolders, size_t maxMemory = 64 * 1024 * 1024);
+
+    struct CacheStats {
+        uint64_t hits = 0; // folders found by fromPath()
+        uint64_t misses = 0; // folders loaded by fromPath()
+        uint64_t evictions = 0; // folders dropped by the retention policy
+        size_t retained = 0; // folders kept by the retention policy
+    };
+
+    static CacheStats cacheStats();
+
+    // the memory taken by the files of folders, in bytes (the sizes of GLib objects are estimated)
+    struct MemoryUsage {
+        size_t folders = 0;
+        size_t files = 0;
+        size_t fileInfos = 0; // FileInfo objects, with their names, paths and targets
+        size_t gFileInfos = 0; // GFileInfo objects retained by FileInfo
+        size_t displayNames = 0;
+        size_t sharedInfos = 0; // MimeType and IconInfo objects, which are shared between folders
+
+        size_t total() const {
+            return fileInfos + gFileInfos + displayNames + sharedInfos;
+        }
+    };
+
+    MemoryUsage memoryUsage() const;
+
+    // the memory taken by all the folders in use or retained (see setRetention())
+    static MemoryUsage totalMemoryUsage();
+
+    // Enables incremental loading for all folders loaded afterwards: the listed files are
+    // added in batches of at most batchSize files or every batchInterval milliseconds,
+    // instead of all at once when the listing is finished.
+    // (Some virtual folders, like search:///, are always loaded incrementally.)
+    static void setIncrementalLoading(bool incremental, size_t batchSize = 1000, int batchInterval = 250);
+
+    static bool incrementalLoading() {
+        return incrementalLoading_;
+    }
+
+    // If enabled, local folders are first listed with content types guessed from the file names only.
+    // The content of the files whose types cannot be guessed is tested later in the background,
+    // and filesChanged() is emitted for them in batches.
+    static void setDeferContentTest(bool defer);
+
+    static bool deferContentTest() {
+        return deferContentTest_;
+    }
+
+    // Sets the delay (in ms) before processing the changes reported by file monitors;
+    // the changes coming in the meantime are processed together. A folder that keeps
+    // changing uses longer delays, up to maxDelay, and returns to minDelay once idle.
+    static void setUpdateDelay(int minDelay, int maxDelay);
+
+    // If enabled, the listings of local folders with at least minFiles files are saved on disk
+    // (see FolderSnapshot). When such a folder is loaded again and no file was added or removed
+    // in it since then, its files are shown at once and then reconciled with a new listing.
+    static void setSnapshotCache(bool enable, size_t minFiles = 1000);
+
+    static bool snapshotCache() {
+        return snapshotCache_;
+    }
+
     bool makeDirectory(const char* name, GError** error);
 
     void queryFilesystemInfo();
@@ -136,6 +207,14 @@ private:
     void queueUpdate();
     void queueReload();
 
+    void addListedFiles(const FileInfoList& infos);
+
+    size_t memoryEstimate() const;
+
+    void addMemoryUsage(MemoryUsage& usage, std::unordered_set<const void*>& sharedInfos) const;
+
+    static void retainFolder(const std::shared_ptr<Folder>& folder, std::vector<std::shared_ptr<Folder>>& evicted);
+
     bool eventFileAdded(const FilePath &path);
     bool eventFileChanged(const FilePath &path);
     void eventFileDeleted(const FilePath &path);
@@ -146,6 +225,10 @@ private Q_SLOTS:
 
     void onDirListFinished();
 
+    void onDirListFilesFound(FileInfoList& files);
+
+    void onDirListSnapshotLoaded(FileInfoList& files);
+
     void onFileSystemInfoFinished();
 
     void onFileInfoFinished();
@@ -170,9 +253,15 @@ private:
     /* for file monitor */
     bool has_idle_reload_handler;
     bool has_idle_update_handler;
-    FilePathList paths_to_add;
-    FilePathList paths_to_update;
-    FilePathList paths_to_del;
+    int update_delay; // current delay of updates, which adapts to the rate of changes
+    QElapsedTimer last_update_time;
+    enum PendingChange: unsigned char {
+        PENDING_ADD = 1 << 0,
+        PENDING_UPDATE = 1 << 1,
+        PENDING_DEL = 1 << 2
+    };
+    std::unordered_map<FilePath, unsigned char, FilePathHash> pending_changes; // PendingChange flags per file
+    FilePathList paths_to_sniff; // files whose content types are to be tested (see defer_content_test)
     // GSList* pending_jobs;
     bool pending_change_notify;
     bool filesystem_info_pending;
@@ -180,10 +269,14 @@ private:
     bool wants_incremental;
     bool stop_emission; /* don't set it 1 bit to not lock other bits */
 
-    // NOTE: Here, FileInfo::path().baseName().get() should be used as the key value, not FileInfo::name(),
+    // NOTE: Here, FileInfo::baseName() (i.e., FileInfo::path().baseName()) should be used as the key value, not FileInfo::name(),
     // because the latter is not always the same as the former and the former will be used for comparison.
     std::unordered_map<const std::string, std::shared_ptr<const FileInfo>, std::hash<std::string>> files_;
 
+    // the files loaded from the snapshot that are not listed yet (see setSnapshotCache())
+    std::unordered_map<std::string, std::shared_ptr<const FileInfo>> unconfirmed_files;
+    FolderSnapshot::DirStamp dir_stamp; // the stamp of the folder before it is listed
+
     /* filesystem info - set in query thread, read in main */
     uint64_t fs_total_size;
     uint64_t fs_free_size;
@@ -191,12 +284,27 @@ private:
 
     bool has_fs_info : 1;
     bool defer_content_test : 1;
+    bool has_dir_stamp : 1;
+    bool snapshot_valid : 1; // the loaded snapshot matches the listing so far
 
     static std::unordered_map<FilePath, std::weak_ptr<Folder>, FilePathHash> cache_;
+    static std::list<std::shared_ptr<Folder>> retainedFolders_; // most recently used first
+    static size_t maxRetainedFolders_;
+    static size_t maxRetainedMemory_;
+    static CacheStats cacheStats_;
     static QString cutFilesDirPath_;
     static QString lastCutFilesDirPath_;
     static std::shared_ptr<const HashSet> cutFilesHashSet_;
     static std::mutex mutex_;
+
+    static bool incrementalLoading_;
+    static size_t incrementalBatchSize_;
+    static int incrementalBatchInterval_;
+    static bool deferContentTest_;
+    static int minUpdateDelay_;
+    static int maxUpdateDelay_;
+    static bool snapshotCache_;
+    static size_t snapshotMinFiles_;
 };
 
 }
@@ -0,0 +1,473 @@
+// Persistent snapshots of folder listings (see foldersnapshot.h)
+//
+// File layout (native byte order, since the snapshots never leave the machine):
+//   header: magic, version, the stamp of the folder, and its URI
+//   attribute names: each name is stored once and referred to by index
+//   files: for each file, a list of (name index, GFileAttributeType, value)
+// Icons are stored as strings (see g_icon_to_string()).
+
+#include "foldersnapshot.h"
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <QByteArray>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDir>
+#include <QDateTime>
+#include <QRunnable>
+#include <QThreadPool>
+#include "cstrptr.h"
+#include "gioptrs.h"
+
+namespace Fm {
+
+static const char snapshotMagic[8] = {'F', 'M', 'Q', 'T', 'S', 'N', 'A', 'P'};
+static const uint32_t snapshotVersion = 1;
+
+// the snapshots that were not used for the longest time are removed beyond these limits
+static const int maxSnapshotCount = 256;
+static const qint64 maxSnapshotBytes = 64 * 1024 * 1024;
+static const qint64 maxSnapshotAge = 30 * 24 * 3600; // in seconds
+
+namespace {
+
+class SnapshotWriter {
+public:
+    template<typename T>
+    void write(T value) {
+        data_.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void writeString(const char* str) {
+        uint32_t len = str ? strlen(str) : 0;
+        write(len);
+        data_.append(str, len);
+    }
+
+    void writeAttribute(GFileInfo* inf, const char* name, uint16_t nameIdx) {
+        auto type = g_file_info_get_attribute_type(inf, name);
+        switch(type) {
+        case G_FILE_ATTRIBUTE_TYPE_STRING:
+            writeHeader(nameIdx, type);
+            writeString(g_file_info_get_attribute_string(inf, name));
+            break;
+        case G_FILE_ATTRIBUTE_TYPE_BYTE_STRING:
+            writeHeader(nameIdx, type);
+            writeString(g_file_info_get_attribute_byte_string(inf, name));
+            break;
+        case G_FILE_ATTRIBUTE_TYPE_BOOLEAN:
+            writeHeader(nameIdx, type);
+            write<uint8_t>(g_file_info_get_attribute_boolean(inf, name));
+            break;
+        case G_FILE_ATTRIBUTE_TYPE_UINT32:
+            writeHeader(nameIdx, type);
+            write<uint32_t>(g_file_info_get_attribute_uint32(inf, name));
+            break;
+        case G_FILE_ATTRIBUTE_TYPE_INT32:
+            writeHeader(nameIdx, type);
+            write<int32_t>(g_file_info_get_attribute_int32(inf, name));
+            break;
+        case G_FILE_ATTRIBUTE_TYPE_UINT64:
+            writeHeader(nameIdx, type);
+            write<uint64_t>(g_file_info_get_attribute_uint64(inf, name));
+            break;
+        case G_FILE_ATTRIBUTE_TYPE_INT64:
+            writeHeader(nameIdx, type);
+            write<int64_t>(g_file_info_get_attribute_int64(inf, name));
+            break;
+        case G_FILE_ATTRIBUTE_TYPE_OBJECT: {
+            // only icons can be stored
+            GObject* obj = g_file_info_get_attribute_object(inf, name);
+            if(obj && G_IS_ICON(obj)) {
+                CStrPtr str{g_icon_to_string(G_ICON(obj))};
+                if(str) {
+                    writeHeader(nameIdx, type);
+                    writeString(str.get());
+                }
+            }
+            break;
+        }
+        case G_FILE_ATTRIBUTE_TYPE_STRINGV: {
+            char** strv = g_file_info_get_attribute_stringv(inf, name);
+            writeHeader(nameIdx, type);
+            write<uint32_t>(strv ? g_strv_length(strv) : 0);
+            for(char** str = strv; str && *str; ++str) {
+                writeString(*str);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    QByteArray& data() {
+        return data_;
+    }
+
+    int attributeCount() const {
+        return attrCount_;
+    }
+
+    void resetAttributeCount() {
+        attrCount_ = 0;
+    }
+
+private:
+    void writeHeader(uint16_t nameIdx, GFileAttributeType type) {
+        write(nameIdx);
+        write<uint8_t>(type);
+        ++attrCount_;
+    }
+
+private:
+    QByteArray data_;
+    int attrCount_ = 0;
+};
+
+class SnapshotReader {
+public:
+    explicit SnapshotReader(const char* data, size_t size): pos_{data}, end_{data + size} {
+    }
+
+    // the number of bytes that are not read yet
+    size_t remaining() const {
+        return end_ - pos_;
+    }
+
+    template<typename T>
+    bool read(T& value) {
+        if(size_t(end_ - pos_) < sizeof(T)) {
+            return false;
+        }
+        memcpy(&value, pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return true;
+    }
+
+    bool readString(std::string& str) {
+        uint32_t len;
+        if(!read(len) || size_t(end_ - pos_) < len) {
+            return false;
+        }
+        str.assign(pos_, len);
+        pos_ += len;
+        return true;
+    }
+
+    bool readAttribute(GFileInfo* inf, const char* name, GFileAttributeType type) {
+        switch(type) {
+        case G_FILE_ATTRIBUTE_TYPE_STRING:
+            if(!readString(str_)) {
+                return false;
+            }
+            g_file_info_set_attribute_string(inf, name, str_.c_str());
+            return true;
+        case G_FILE_ATTRIBUTE_TYPE_BYTE_STRING:
+            if(!readString(str_)) {
+                return false;
+            }
+            g_file_info_set_attribute_byte_string(inf, name, str_.c_str());
+            return true;
+        case G_FILE_ATTRIBUTE_TYPE_BOOLEAN: {
+            uint8_t value;
+            if(!read(value)) {
+                return false;
+            }
+            g_file_info_set_attribute_boolean(inf, name, value);
+            return true;
+        }
+        case G_FILE_ATTRIBUTE_TYPE_UINT32: {
+            uint32_t value;
+            if(!read(value)) {
+                return false;
+            }
+            g_file_info_set_attribute_uint32(inf, name, value);
+            return true;
+        }
+        case G_FILE_ATTRIBUTE_TYPE_INT32: {
+            int32_t value;
+            if(!read(value)) {
+                return false;
+            }
+            g_file_info_set_attribute_int32(inf, name, value);
+            return true;
+        }
+        case G_FILE_ATTRIBUTE_TYPE_UINT64: {
+            uint64_t value;
+            if(!read(value)) {
+                return false;
+            }
+            g_file_info_set_attribute_uint64(inf, name, value);
+            return true;
+        }
+        case G_FILE_ATTRIBUTE_TYPE_INT64: {
+            int64_t value;
+            if(!read(value)) {
+                return false;
+            }
+            g_file_info_set_attribute_int64(inf, name, value);
+            return true;
+        }
+        case G_FILE_ATTRIBUTE_TYPE_OBJECT: {
+            if(!readString(str_)) {
+                return false;
+            }
+            // most files share a few icons
+            auto it = icons_.find(str_);
+            if(it == icons_.end()) {
+                GIconPtr icon{g_icon_new_for_string(str_.c_str(), nullptr), false};
+                if(!icon) {
+                    return false;
+                }
+                it = icons_.emplace(str_, std::move(icon)).first;
+            }
+            g_file_info_set_attribute_object(inf, name, G_OBJECT(it->second.get()));
+            return true;
+        }
+        case G_FILE_ATTRIBUTE_TYPE_STRINGV: {
+            uint32_t n;
+            if(!read(n) || n > size_t(end_ - pos_) / sizeof(uint32_t)) {
+                return false;
+            }
+            std::vector<std::string> strs(n);
+            std::vector<char*> strv;
+            for(auto& str: strs) {
+                if(!readString(str)) {
+                    return false;
+                }
+                strv.push_back(&str[0]);
+            }
+            strv.push_back(nullptr);
+            g_file_info_set_attribute_stringv(inf, name, strv.data());
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+private:
+    const char* pos_;
+    const char* end_;
+    std::string str_;
+    std::unordered_map<std::string, GIconPtr> icons_;
+};
+
+class SaveSnapshotTask: public QRunnable {
+public:
+    explicit SaveSnapshotTask(const QString& fileName, const FilePath& dirPath,
+                              const FolderSnapshot::DirStamp& stamp, const FileInfoList& files):
+        fileName_{fileName},
+        uri_{dirPath.uri()},
+        stamp_(stamp),
+        files_{files} {
+    }
+
+    void run() override {
+        // the files are written first to collect the names of their attributes
+        SnapshotWriter filesWriter;
+        std::unordered_map<std::string, uint16_t> nameIndices;
+        std::vector<const char*> names;
+        filesWriter.write<uint32_t>(files_.size());
+        for(auto& file: files_) {
+            auto inf = file->gFileInfo();
+            int countPos = filesWriter.data().size();
+            filesWriter.write<uint16_t>(0);
+            filesWriter.resetAttributeCount();
+            if(inf) {
+                CStrArrayPtr attrs{g_file_info_list_attributes(inf.get(), nullptr)};
+                for(char** attr = attrs.get(); attr && *attr; ++attr) {
+                    auto res = nameIndices.emplace(*attr, names.size());
+                    if(res.second) {
+                        names.push_back(res.first->first.c_str());
+                    }
+                    filesWriter.writeAttribute(inf.get(), *attr, res.first->second);
+                }
+            }
+            uint16_t count = filesWriter.attributeCount();
+            memcpy(filesWriter.data().data() + countPos, &count, sizeof(count));
+        }
+
+        SnapshotWriter writer;
+        writer.data().append(snapshotMagic, sizeof(snapshotMagic));
+        writer.write(snapshotVersion);
+        writer.write(stamp_.mtime);
+        writer.write(stamp_.mtimeNsec);
+        writer.write(stamp_.ctime);
+        writer.write(stamp_.ctimeNsec);
+        writer.write(stamp_.dev);
+        writer.write(stamp_.ino);
+        writer.writeString(uri_.get());
+        writer.write<uint32_t>(names.size());
+        for(auto name: names) {
+            writer.writeString(name);
+        }
+        writer.data().append(filesWriter.data());
+
+        // the listings of private folders should only be readable by the user
+        const QString dir = QFileInfo(fileName_).absolutePath();
+        const QByteArray localDir = QFile::encodeName(dir);
+        if(g_mkdir_with_parents(localDir.constData(), 0700) != 0 || g_chmod(localDir.constData(), 0700) != 0) {
+            return;
+        }
+        QSaveFile file(fileName_);
+        if(file.open(QIODevice::WriteOnly)) {
+            file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+            file.write(writer.data());
+            file.commit();
+        }
+        pruneSnapshots(dir);
+    }
+
+private:
+    // removes the snapshots that were not used for maxSnapshotAge, and then the least recently
+    // used ones until there are at most maxSnapshotCount of them, of maxSnapshotBytes in total
+    // (a snapshot is touched whenever it is loaded, see FolderSnapshot::load())
+    static void pruneSnapshots(const QString& dir) {
+        const QFileInfoList entries = QDir{dir}.entryInfoList(QDir::Files | QDir::Hidden, QDir::Time); // newest first
+        const QDateTime oldest = QDateTime::currentDateTime().addSecs(-maxSnapshotAge);
+        qint64 totalBytes = 0;
+        int count = 0;
+        for(const QFileInfo& entry : entries) {
+            totalBytes += entry.size();
+            ++count;
+            if(count > maxSnapshotCount || totalBytes > maxSnapshotBytes || entry.lastModified() < oldest) {
+                QFile::remove(entry.filePath());
+            }
+        }
+    }
+
+private:
+    QString fileName_;
+    CStrPtr uri_;
+    FolderSnapshot::DirStamp stamp_;
+    FileInfoList files_;
+};
+
+class RemoveSnapshotTask: public QRunnable {
+public:
+    explicit RemoveSnapshotTask(const QString& fileName): fileName_{fileName} {
+    }
+
+    void run() override {
+        QFile::remove(fileName_);
+    }
+
+private:
+    QString fileName_;
+};
+
+} // namespace
+
+// static
+QString FolderSnapshot::snapshotFile(const FilePath& dirPath) {
+    auto uri = dirPath.uri();
+    CStrPtr md5{g_compute_checksum_for_string(G_CHECKSUM_MD5, uri.get(), -1)};
+    return QString::fromUtf8(g_get_user_cache_dir()) + QStringLiteral("/libfm-qt/folders/") + QString::fromLatin1(md5.get());
+}
+
+// static
+bool FolderSnapshot::dirStamp(const FilePath& dirPath, DirStamp& stamp) {
+    auto localPath = dirPath.localPath();
+    struct stat st;
+    if(!localPath || stat(localPath.get(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return false;
+    }
+    stamp.mtime = st.st_mtim.tv_sec;
+    stamp.mtimeNsec = st.st_mtim.tv_nsec;
+    stamp.ctime = st.st_ctim.tv_sec;
+    stamp.ctimeNsec = st.st_ctim.tv_nsec;
+    stamp.dev = st.st_dev;
+    stamp.ino = st.st_ino;
+    return true;
+}
+
+// static
+bool FolderSnapshot::load(const FilePath& dirPath, const DirStamp& stamp, FileInfoList& files) {
+    QFile file(snapshotFile(dirPath));
+    if(!file.open(QIODevice::ReadOnly) || file.size() == 0) {
+        return false;
+    }
+    uchar* data = file.map(0, file.size());
+    if(!data) {
+        return false;
+    }
+    SnapshotReader reader{reinterpret_cast<const char*>(data), size_t(file.size())};
+
+    bool ok = false;
+    char magic[sizeof(snapshotMagic)];
+    uint32_t version;
+    DirStamp fileStamp;
+    std::string uri;
+    uint32_t nameCount;
+    uint32_t fileCount;
+    if(reader.read(magic) && memcmp(magic, snapshotMagic, sizeof(magic)) == 0
+       && reader.read(version) && version == snapshotVersion
+       && reader.read(fileStamp.mtime) && reader.read(fileStamp.mtimeNsec)
+       && reader.read(fileStamp.ctime) && reader.read(fileStamp.ctimeNsec)
+       && reader.read(fileStamp.dev) && reader.read(fileStamp.ino)
+       && fileStamp == stamp
+       && reader.readString(uri) && uri == dirPath.uri().get()
+       && reader.read(nameCount)
+       // each name takes at least its length, so a corrupted count is rejected before allocating
+       && nameCount <= reader.remaining() / sizeof(uint32_t)) {
+        std::vector<std::string> names;
+        ok = true;
+        for(uint32_t i = 0; i < nameCount; ++i) {
+            names.emplace_back();
+            if(!reader.readString(names.back())) {
+                ok = false;
+                break;
+            }
+        }
+        // and each file takes at least its number of attributes
+        ok = ok && reader.read(fileCount) && fileCount <= reader.remaining() / sizeof(uint16_t);
+        if(ok) {
+            for(uint32_t i = 0; ok && i < fileCount; ++i) {
+                uint16_t attrCount;
+                ok = reader.read(attrCount);
+                GFileInfoPtr inf{g_file_info_new(), false};
+                for(uint16_t j = 0; ok && j < attrCount; ++j) {
+                    uint16_t nameIdx;
+                    uint8_t type;
+                    ok = reader.read(nameIdx) && nameIdx < names.size()
+                         && reader.read(type)
+                         && reader.readAttribute(inf.get(), names[nameIdx].c_str(), GFileAttributeType(type));
+                }
+                if(ok) {
+                    files.push_back(std::make_shared<FileInfo>(inf, FilePath(), dirPath));
+                }
+            }
+        }
+    }
+    file.unmap(data);
+
+    if(ok) {
+        // mark the snapshot as recently used, so that it is pruned last (see SaveSnapshotTask)
+        utimes(QFile::encodeName(file.fileName()).constData(), nullptr);
+    }
+    else {
+        files.clear();
+    }
+    return ok;
+}
+
+// static
+void FolderSnapshot::save(const FilePath& dirPath, const DirStamp& stamp, const FileInfoList& files) {
+    QThreadPool::globalInstance()->start(new SaveSnapshotTask{snapshotFile(dirPath), dirPath, stamp, files});
+}
+
+// static
+void FolderSnapshot::remove(const FilePath& dirPath) {
+    QThreadPool::globalInstance()->start(new RemoveSnapshotTask{snapshotFile(dirPath)});
+}
+
+} // namespace Fm
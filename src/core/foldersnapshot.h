@@ -0,0 +1,56 @@
+#ifndef FM2_FOLDERSNAPSHOT_H
+#define FM2_FOLDERSNAPSHOT_H
+
+#include <cstdint>
+#include <QString>
+#include "../libfmqtglobals.h"
+#include "filepath.h"
+#include "fileinfo.h"
+
+namespace Fm {
+
+// Persistent snapshots of the listings of local folders, used to show the files of a folder
+// at once when it is opened again, before a new listing is finished.
+// Each snapshot is a compact file in the user cache dir (~/.cache/libfm-qt/folders), which is
+// memory-mapped when loaded. It is valid as long as the folder keeps the same stamp, i.e., as long
+// as no file is added, removed or renamed in it. Changes to the files themselves do not change the
+// stamp, so the loaded files should always be reconciled with a new listing (see Folder::reload()).
+// The snapshots are only readable by the user, and the least recently used ones are removed when
+// there are too many of them, or when they are too big in total or too old (see foldersnapshot.cpp).
+class LIBFM_QT_API FolderSnapshot {
+public:
+    // the modification and status change times of a folder, with its device and inode numbers
+    struct DirStamp {
+        int64_t mtime = 0;
+        int64_t mtimeNsec = 0;
+        int64_t ctime = 0;
+        int64_t ctimeNsec = 0;
+        uint64_t dev = 0;
+        uint64_t ino = 0;
+
+        bool operator==(const DirStamp& other) const {
+            return mtime == other.mtime && mtimeNsec == other.mtimeNsec
+                   && ctime == other.ctime && ctimeNsec == other.ctimeNsec
+                   && dev == other.dev && ino == other.ino;
+        }
+    };
+
+    // gets the current stamp of a local folder
+    static bool dirStamp(const FilePath& dirPath, DirStamp& stamp);
+
+    // loads the snapshot of a folder if it was saved with the same stamp (in a job thread)
+    static bool load(const FilePath& dirPath, const DirStamp& stamp, FileInfoList& files);
+
+    // saves the snapshot of a folder in a worker thread, replacing the old one
+    static void save(const FilePath& dirPath, const DirStamp& stamp, const FileInfoList& files);
+
+    // removes the snapshot of a folder in a worker thread
+    static void remove(const FilePath& dirPath);
+
+private:
+    static QString snapshotFile(const FilePath& dirPath);
+};
+
+} // namespace Fm
+
+#endif // FM2_FOLDERSNAPSHOT_H
@@ -0,0 +1,20 @@
+#ifndef MEMORYUSAGE_P_H
+#define MEMORYUSAGE_P_H
+
+#include <string>
+#include <QString>
+
+namespace Fm {
+
+// the heap memory taken by strings, excluding short strings stored inline
+inline size_t stringMemory(const std::string& str) {
+    return str.capacity() > 15 ? str.capacity() + 1 : 0;
+}
+
+inline size_t stringMemory(const QString& str) {
+    return str.isNull() ? 0 : sizeof(QArrayData) + (str.capacity() + 1) * sizeof(QChar);
+}
+
+} // namespace Fm
+
+#endif // MEMORYUSAGE_P_H
@@ -58,8 +58,14 @@ public:
     }
 
     void forEachThumbnailer(std::function<bool(const std::shared_ptr<const Thumbnailer>&)> func) const {
-        std::lock_guard<std::mutex> lock{mutex_};
-        for(auto& thumbnailer: thumbnailers_) {
+        // NOTE: The list is copied, so that the thumbnailers of the files of the same type
+        // can be run in several threads at once.
+        std::vector<std::shared_ptr<const Thumbnailer>> thumbnailers;
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            thumbnailers.assign(thumbnailers_.cbegin(), thumbnailers_.cend());
+        }
+        for(auto& thumbnailer: thumbnailers) {
             if(func(thumbnailer)) {
                 break;
             }
@@ -0,0 +1,51 @@
+#include "parallelfor.h"
+#include <QThreadPool>
+#include <QSemaphore>
+#include <QThread>
+#include <algorithm>
+
+namespace Fm {
+
+Q_GLOBAL_STATIC(QThreadPool, parallelThreadPool)
+
+namespace {
+
+class ParallelTask: public QRunnable {
+public:
+    ParallelTask(const std::function<void (size_t)>& func, size_t index, QSemaphore* done):
+        func_{func},
+        index_{index},
+        done_{done} {
+    }
+
+    void run() override {
+        func_(index_);
+        done_->release();
+    }
+
+private:
+    const std::function<void (size_t)>& func_;
+    size_t index_;
+    QSemaphore* done_;
+};
+
+}
+
+void parallelFor(size_t count, const std::function<void (size_t)>& func) {
+    if(count == 0) {
+        return;
+    }
+    QSemaphore done;
+    for(size_t i = 1; i < count; ++i) {
+        parallelThreadPool()->start(new ParallelTask(func, i, &done));
+    }
+    // the current thread does its share too
+    func(0);
+    done.acquire(int(count) - 1);
+}
+
+size_t parallelChunkCount(size_t count, size_t minChunkSize) {
+    return std::max(size_t(1), std::min(size_t(QThread::idealThreadCount()), count / minChunkSize));
+}
+
+} // namespace Fm
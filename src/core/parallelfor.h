@@ -0,0 +1,21 @@
+#ifndef FM2_PARALLELFOR_H
+#define FM2_PARALLELFOR_H
+
+#include "../libfmqtglobals.h"
+#include <functional>
+#include <cstddef>
+
+namespace Fm {
+
+// Calls func(0) ... func(count - 1) in worker threads (and in the calling thread) and waits for them.
+// NOTE: A separate thread pool is used, since the caller may be a job that runs in the global pool,
+// which could be full of jobs waiting for their tasks.
+LIBFM_QT_API void parallelFor(size_t count, const std::function<void (size_t)>& func);
+
+// The number of chunks a loop of count iterations is split into, with at least minChunkSize
+// iterations per chunk and at most as many chunks as there are cores.
+LIBFM_QT_API size_t parallelChunkCount(size_t count, size_t minChunkSize);
+
+}
+
+#endif // FM2_PARALLELFOR_H
@@ -2,9 +2,25 @@
 #include <string>
 #include <memory>
 #include <algorithm>
+#include <functional>
 #include <libexif/exif-loader.h>
 #include <QImageReader>
+#include <QIODevice>
+#include <QBuffer>
 #include <QDir>
+#include <QSaveFile>
+#include <QTemporaryFile>
+#include <QSet>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSemaphore>
+#include <QThread>
+#include <QDateTime>
+#include <glib/gstdio.h>
+#include <climits>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 #include "thumbnailer.h"
 
 #include "core/legacy/fm-config.h"
@@ -14,53 +30,438 @@ namespace Fm {
 QThreadPool* ThumbnailJob::threadPool_ = nullptr;
 
 bool ThumbnailJob::localFilesOnly_ = true;
+bool ThumbnailJob::useMappedFiles_ = false;
 int ThumbnailJob::maxThumbnailFileSize_ = 0;
 
+// local files modified in the last seconds are not mapped into memory (see generateThumbnail())
+static const qint64 minMappedFileAge = 60;
+
+namespace {
+
+// limits the number of the threads that read image files at once
+class ReadLimiter {
+public:
+    ReadLimiter():
+        limit_{0},
+        readers_{0} {
+    }
+
+    void setLimit(int limit) {
+        QMutexLocker lock{&mutex_};
+        limit_ = limit;
+        cond_.wakeAll();
+    }
+
+    int limit() {
+        QMutexLocker lock{&mutex_};
+        return limit_;
+    }
+
+    void acquire() {
+        QMutexLocker lock{&mutex_};
+        while(limit_ > 0 && readers_ >= limit_) {
+            cond_.wait(&mutex_);
+        }
+        ++readers_;
+    }
+
+    void release() {
+        QMutexLocker lock{&mutex_};
+        --readers_;
+        cond_.wakeOne();
+    }
+
+private:
+    QMutex mutex_;
+    QWaitCondition cond_;
+    int limit_; // 0 for no limit
+    int readers_;
+};
+
+// holds a slot of the read limiter while reading a file
+class ReadLocker {
+public:
+    explicit ReadLocker(ReadLimiter* limiter): limiter_{limiter} {
+        limiter_->acquire();
+    }
+
+    ~ReadLocker() {
+        limiter_->release();
+    }
+
+private:
+    ReadLimiter* limiter_;
+};
+
+// the thumbnail files that are being generated, so that a thumbnail is not generated by several
+// threads at once (like when two models of a folder, or two sizes of "normal" thumbnails, ask for it)
+class ThumbnailGenerations {
+public:
+    // waits until the thumbnail file is not generated by another thread, and returns true if it was
+    bool acquire(const QString& filename) {
+        QMutexLocker lock{&mutex_};
+        bool waited = false;
+        while(filenames_.contains(filename)) {
+            waited = true;
+            cond_.wait(&mutex_);
+        }
+        filenames_.insert(filename);
+        return waited;
+    }
+
+    void release(const QString& filename) {
+        QMutexLocker lock{&mutex_};
+        filenames_.remove(filename);
+        cond_.wakeAll();
+    }
+
+private:
+    QMutex mutex_;
+    QWaitCondition cond_;
+    QSet<QString> filenames_;
+};
+
+// lets only the current thread generate a thumbnail file
+class GenerationLocker {
+public:
+    GenerationLocker(ThumbnailGenerations* generations, const QString& filename):
+        generations_{generations},
+        filename_{filename} {
+        waited_ = generations_->acquire(filename_);
+    }
+
+    ~GenerationLocker() {
+        generations_->release(filename_);
+    }
+
+    // whether another thread was generating the thumbnail file meanwhile
+    bool waited() const {
+        return waited_;
+    }
+
+private:
+    ThumbnailGenerations* generations_;
+    QString filename_;
+    bool waited_;
+};
+
+// Lets QImageReader read an image file from a GInputStream, so that the file is decoded while it
+// is read, in blocks, instead of being loaded into memory first. A slot of the read limiter is
+// only held while a block is read.
+class InputStreamDevice: public QIODevice {
+public:
+    InputStreamDevice(GInputStream* stream, qint64 size, GCancellable* cancellable, ReadLimiter* limiter):
+        stream_{stream},
+        size_{size},
+        cancellable_{cancellable},
+        limiter_{limiter},
+        buffer_{new char[bufferSize]},
+        bufferStart_{0},
+        bufferLen_{0},
+        readPos_{0} {
+        // NOTE: the stream should be at the beginning of the file
+        open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+    }
+
+    bool isSequential() const override {
+        return !G_IS_SEEKABLE(stream_) || !g_seekable_can_seek(G_SEEKABLE(stream_));
+    }
+
+    qint64 size() const override {
+        return size_;
+    }
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override {
+        if(!isSequential()) {
+            readPos_ = pos(); // the image handler may have seeked
+        }
+        if(readPos_ < bufferStart_ || readPos_ >= bufferStart_ + bufferLen_) {
+            if(!fillBuffer(readPos_)) {
+                return -1;
+            }
+            if(bufferLen_ == 0) { // end of file
+                return 0;
+            }
+        }
+        qint64 len = std::min(maxSize, bufferStart_ + bufferLen_ - readPos_);
+        memcpy(data, buffer_.get() + (readPos_ - bufferStart_), len);
+        readPos_ += len;
+        return len;
+    }
+
+    qint64 writeData(const char* /*data*/, qint64 /*maxSize*/) override {
+        return -1;
+    }
+
+private:
+    static const qint64 bufferSize = 64 * 1024;
+
+    bool fillBuffer(qint64 pos) {
+        ReadLocker lock{limiter_};
+        // the stream is at the end of the buffer
+        if(pos != bufferStart_ + bufferLen_
+           && !g_seekable_seek(G_SEEKABLE(stream_), pos, G_SEEK_SET, cancellable_, nullptr)) {
+            return false;
+        }
+        gssize readSize = g_input_stream_read(stream_, buffer_.get(), bufferSize, cancellable_, nullptr);
+        if(readSize < 0) { // error or cancelled
+            return false;
+        }
+        bufferStart_ = pos;
+        bufferLen_ = readSize;
+        return true;
+    }
+
+    GInputStream* stream_;
+    qint64 size_;
+    GCancellable* cancellable_;
+    ReadLimiter* limiter_;
+    std::unique_ptr<char[]> buffer_;
+    qint64 bufferStart_; // the position of the buffer in the file
+    qint64 bufferLen_;
+    qint64 readPos_;
+};
+
+struct MappedFileDeleter {
+    void operator()(GMappedFile* mappedFile) const {
+        g_mapped_file_unref(mappedFile);
+    }
+};
+
+typedef std::unique_ptr<GMappedFile, MappedFileDeleter> MappedFilePtr;
+
+// the thumbnails that were loaded recently, with the least recently used ones evicted first
+class ThumbnailMemoryCache {
+public:
+    ThumbnailMemoryCache():
+        maxBytes_{64 * 1024 * 1024} {
+    }
+
+    // the lookups that are not counted in the stats are those of the GUI, which would count
+    // the misses of the thumbnails that are not loaded yet once per painting
+    QImage find(const char* uri, int size, quint64 mtime, quint64 fileSize, bool countStats = true) {
+        std::lock_guard<std::mutex> lock{mutex_};
+        auto it = index_.find(makeKey(uri, size));
+        if(it == index_.end()) {
+            stats_.misses += countStats;
+            return QImage();
+        }
+        auto entry = it->second;
+        if(entry->mtime != mtime || entry->fileSize != fileSize) { // the file is changed
+            stats_.misses += countStats;
+            erase(it);
+            return QImage();
+        }
+        stats_.hits += countStats;
+        entries_.splice(entries_.begin(), entries_, entry);
+        return entry->image;
+    }
+
+    void insert(const char* uri, int size, quint64 mtime, quint64 fileSize, const QImage& image) {
+        std::string key = makeKey(uri, size);
+#if (QT_VERSION >= QT_VERSION_CHECK(5,10,0))
+        const size_t bytes = image.sizeInBytes() + 2 * key.size();
+#else
+        const size_t bytes = image.byteCount() + 2 * key.size();
+#endif
+        std::lock_guard<std::mutex> lock{mutex_};
+        auto it = index_.find(key);
+        if(it != index_.end()) {
+            erase(it);
+        }
+        if(bytes > maxBytes_) {
+            return;
+        }
+        entries_.push_front(Entry{key, mtime, fileSize, image, bytes});
+        index_.emplace(std::move(key), entries_.begin());
+        stats_.bytes += bytes;
+        evict(maxBytes_);
+    }
+
+    void setMaxBytes(size_t maxBytes) {
+        std::lock_guard<std::mutex> lock{mutex_};
+        maxBytes_ = maxBytes;
+        evict(maxBytes_);
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock{mutex_};
+        index_.clear();
+        entries_.clear();
+        stats_.bytes = 0;
+    }
+
+    ThumbnailJob::MemoryCacheStats stats() {
+        std::lock_guard<std::mutex> lock{mutex_};
+        ThumbnailJob::MemoryCacheStats stats = stats_;
+        stats.thumbnails = entries_.size();
+        return stats;
+    }
+
+private:
+    struct Entry {
+        std::string key;
+        quint64 mtime;
+        quint64 fileSize;
+        QImage image;
+        size_t bytes;
+    };
+
+    typedef std::unordered_map<std::string, std::list<Entry>::iterator> Index;
+
+    static std::string makeKey(const char* uri, int size) {
+        std::string key = std::to_string(size);
+        key += ' ';
+        key += uri;
+        return key;
+    }
+
+    void erase(Index::iterator it) {
+        stats_.bytes -= it->second->bytes;
+        entries_.erase(it->second);
+        index_.erase(it);
+    }
+
+    void evict(size_t maxBytes) {
+        while(stats_.bytes > maxBytes && !entries_.empty()) {
+            erase(index_.find(entries_.back().key));
+            ++stats_.evictions;
+        }
+    }
+
+    std::mutex mutex_;
+    std::list<Entry> entries_; // the most recently used first
+    Index index_;
+    size_t maxBytes_;
+    ThumbnailJob::MemoryCacheStats stats_;
+};
+
+// loads the files of a job in another thread of the pool
+class ThumbnailHelper: public QRunnable {
+public:
+    ThumbnailHelper(const std::function<void ()>& func, QSemaphore* done):
+        func_{func},
+        done_{done} {
+    }
+
+    void run() override {
+        func_();
+        done_->release();
+    }
+
+private:
+    std::function<void ()> func_;
+    QSemaphore* done_;
+};
+
+}
+
+Q_GLOBAL_STATIC(ReadLimiter, readLimiter)
+Q_GLOBAL_STATIC(ThumbnailMemoryCache, memoryCache)
+Q_GLOBAL_STATIC(ThumbnailGenerations, thumbnailGenerations)
+
 ThumbnailJob::ThumbnailJob(FileInfoList files, int size):
     files_{std::move(files)},
     size_{size},
-    md5Calc_{g_checksum_new(G_CHECKSUM_MD5)} {
+    nextFile_{0} {
 }
 
 ThumbnailJob::~ThumbnailJob() {
-    g_checksum_free(md5Calc_);
     // qDebug("delete  ThumbnailJob");
 }
 
 void ThumbnailJob::exec() {
-    for(auto& file: files_) {
-        if(isCancelled()) {
+    results_.resize(files_.size());
+    nextFile_ = 0;
+    // The idle threads of the pool help with the files. They are not queued, since the pool
+    // may be full of other jobs, and then this job would wait for them instead of working.
+    QSemaphore done;
+    int n_helpers = 0;
+    while(size_t(n_helpers) + 1 < files_.size()) {
+        auto helper = new ThumbnailHelper([this]() {
+            loadFiles();
+        }, &done);
+        if(!threadPool()->tryStart(helper)) {
+            delete helper; // NOTE: the pool does not take the ownership if it cannot start the task
             break;
         }
-        auto image = loadForFile(file);
+        ++n_helpers;
+    }
+    loadFiles();
+    done.acquire(n_helpers);
+}
+
+// loads the thumbnails of the files that are not taken by other threads
+void ThumbnailJob::loadFiles() {
+    // NOTE: GChecksum is not thread-safe, so each thread has its own one.
+    GChecksum* md5Calc = g_checksum_new(G_CHECKSUM_MD5);
+    for(size_t i = nextFile_++; i < files_.size() && !isCancelled(); i = nextFile_++) {
+        const auto& file = files_[i];
+        auto image = loadForFile(file, md5Calc);
         Q_EMIT thumbnailLoaded(file, size_, image);
-        results_.emplace_back(std::move(image));
+        results_[i] = std::move(image);
     }
+    g_checksum_free(md5Calc);
 }
 
-QImage ThumbnailJob::readImageFromStream(GInputStream* stream, size_t len) {
-    // FIXME: should we set a limit here? Otherwise if len is too large, we can run out of memory.
-    std::unique_ptr<unsigned char[]> buffer{new unsigned char[len]}; // allocate enough buffer
-    unsigned char* pbuffer = buffer.get();
-    size_t totalReadSize = 0;
-    while(!isCancelled() && totalReadSize < len) {
-        size_t bytesToRead = totalReadSize + 4096 > len ? len - totalReadSize : 4096;
-        gssize readSize = g_input_stream_read(stream, pbuffer, bytesToRead, cancellable_.get(), nullptr);
-        if(readSize == 0) { // end of file
-            break;
+QImage ThumbnailJob::readImageFromStream(GInputStream* stream, size_t len, int targetSize) {
+    InputStreamDevice device{stream, qint64(len), cancellable_.get(), readLimiter()};
+    return readImage(&device, targetSize);
+}
+
+// whether the file is on a local disk, and not on a remote or FUSE file system
+bool ThumbnailJob::isLocalFileSystem(const FilePath& path) {
+    GFileInfoPtr fsInfo{g_file_query_filesystem_info(path.gfile().get(),
+                                                     G_FILE_ATTRIBUTE_FILESYSTEM_REMOTE "," G_FILE_ATTRIBUTE_FILESYSTEM_TYPE,
+                                                     nullptr, nullptr), false};
+    if(!fsInfo || g_file_info_get_attribute_boolean(fsInfo.get(), G_FILE_ATTRIBUTE_FILESYSTEM_REMOTE)) {
+        return false;
+    }
+    const char* fsType = g_file_info_get_attribute_string(fsInfo.get(), G_FILE_ATTRIBUTE_FILESYSTEM_TYPE);
+    if(!fsType) {
+        return false;
+    }
+    static const char* const remoteTypes[] = {"nfs", "nfs4", "cifs", "smb", "smb2", "smb3", "smbfs", "ncpfs", "afs", "9p", "ceph", "glusterfs", "davfs"};
+    for(const char* remoteType : remoteTypes) {
+        if(strcmp(fsType, remoteType) == 0) {
+            return false;
         }
-        else if(readSize == -1) { // error
-            return QImage();
+    }
+    return strncmp(fsType, "fuse", 4) != 0; // like "fuse.sshfs" or "fuseblk"
+}
+
+QImage ThumbnailJob::readImageFromData(const unsigned char* data, size_t len, int targetSize) {
+    if(len > size_t(INT_MAX)) { // QByteArray cannot refer to more than INT_MAX bytes
+        return QImage();
+    }
+    // the decoder reads the mapped file in place, without copying it into a buffer first
+    QByteArray bytes = QByteArray::fromRawData(reinterpret_cast<const char*>(data), int(len));
+    QBuffer buffer{&bytes};
+    buffer.open(QIODevice::ReadOnly);
+    return readImage(&buffer, targetSize);
+}
+
+QImage ThumbnailJob::readImage(QIODevice* device, int targetSize) {
+    QImageReader reader{device};
+    QSize imageSize = reader.size(); // only the header is read
+    if(imageSize.isValid() && reader.supportsOption(QImageIOHandler::ScaledSize)) {
+        // Decode a large image at a lower resolution (JPEG images are scaled down by libjpeg
+        // while being decoded). Twice the target size is kept, so that the thumbnail has the
+        // same quality after the smooth scaling done by the caller.
+        QSize decodedSize = imageSize.scaled(2 * targetSize, 2 * targetSize, Qt::KeepAspectRatio).expandedTo(QSize(1, 1));
+        if(decodedSize.width() < imageSize.width() && decodedSize.height() < imageSize.height()) {
+            reader.setScaledSize(decodedSize);
         }
-        totalReadSize += readSize;
-        pbuffer += readSize;
     }
     QImage image;
-    image.loadFromData(buffer.get(), totalReadSize);
+    if(!isCancelled()) {
+        reader.read(&image);
+    }
     return image;
 }
 
-QImage ThumbnailJob::loadForFile(const std::shared_ptr<const FileInfo> &file) {
+QImage ThumbnailJob::loadForFile(const std::shared_ptr<const FileInfo> &file, GChecksum* md5Calc) {
     if(!file->canThumbnail()) {
         return QImage();
     }
@@ -79,25 +480,20 @@ QImage ThumbnailJob::loadForFile(const std::shared_ptr<const FileInfo> &file) {
 
     // generate base name of the thumbnail  => {md5 of uri}.png
     auto origPath = file->path();
-    CStrPtr uri;
-    if(file->isSymlink()) {
-        // use the symlink target in the name to update the thumbnail
-        // if the file is changed to a symlink with the same time stamp
-        auto target = file->target();
-        if(!target.empty()) {
-            uri = FilePath::fromLocalPath(target.c_str()).uri();
-        }
-    }
-    if(!uri) {
-        uri = origPath.uri();
+    CStrPtr uri = thumbnailUri(file);
+
+    // the thumbnail may have been loaded recently
+    QImage cached = memoryCache()->find(uri.get(), size_, file->mtime(), file->size());
+    if(!cached.isNull()) {
+        return cached;
     }
 
     char thumbnailName[32 + 5];
     // calculate md5 hash for the uri of the original file
-    g_checksum_update(md5Calc_, reinterpret_cast<const unsigned char*>(uri.get()), -1);
-    memcpy(thumbnailName, g_checksum_get_string(md5Calc_), 32);
+    g_checksum_update(md5Calc, reinterpret_cast<const unsigned char*>(uri.get()), -1);
+    memcpy(thumbnailName, g_checksum_get_string(md5Calc), 32);
     memcpy(thumbnailName + 32, ".png", 5);
-    g_checksum_reset(md5Calc_); // reset the checksum calculator for next use
+    g_checksum_reset(md5Calc); // reset the checksum calculator for next use
 
     QString thumbnailFilename = thumbnailDir;
     thumbnailFilename += QLatin1Char('/');
@@ -105,22 +501,60 @@ QImage ThumbnailJob::loadForFile(const std::shared_ptr<const FileInfo> &file) {
     // qDebug() << "thumbnail:" << file->getName().c_str() << thumbnailFilename;
 
     // try to load the thumbnail file if it exists
-    QImage thumbnail{thumbnailFilename};
+    QImage thumbnail;
+    {
+        ReadLocker lock{readLimiter()};
+        thumbnail.load(thumbnailFilename);
+    }
     if(thumbnail.isNull() || isThumbnailOutdated(file, thumbnail)) {
         // the existing thumbnail cannot be loaded, generate a new one
+        GenerationLocker generation{thumbnailGenerations(), thumbnailFilename};
+        if(generation.waited()) {
+            // another thread has just generated it
+            ReadLocker lock{readLimiter()};
+            thumbnail.load(thumbnailFilename);
+        }
+        if(thumbnail.isNull() || isThumbnailOutdated(file, thumbnail)) {
+            // create the thumbnail dir as needd (FIXME: Qt file I/O is slow)
+            QDir().mkpath(thumbnailDir);
 
-        // create the thumbnail dir as needd (FIXME: Qt file I/O is slow)
-        QDir().mkpath(thumbnailDir);
-
-        thumbnail = generateThumbnail(file, origPath, uri.get(), thumbnailFilename);
+            thumbnail = generateThumbnail(file, origPath, uri.get(), thumbnailFilename);
+        }
     }
     // resize to the size we need
     if(thumbnail.width() > size_ || thumbnail.height() > size_) {
         thumbnail = thumbnail.scaled(size_, size_, Qt::KeepAspectRatio, Qt::SmoothTransformation);
     }
+    if(!thumbnail.isNull()) {
+        memoryCache()->insert(uri.get(), size_, file->mtime(), file->size(), thumbnail);
+    }
     return thumbnail;
 }
 
+// the URI of the file whose thumbnail is made
+CStrPtr ThumbnailJob::thumbnailUri(const std::shared_ptr<const FileInfo>& file) {
+    CStrPtr uri;
+    if(file->isSymlink()) {
+        // use the symlink target in the name to update the thumbnail
+        // if the file is changed to a symlink with the same time stamp
+        auto target = file->target();
+        if(!target.empty()) {
+            uri = FilePath::fromLocalPath(target.c_str()).uri();
+        }
+    }
+    if(!uri) {
+        uri = file->path().uri();
+    }
+    return uri;
+}
+
+QImage ThumbnailJob::cachedThumbnail(const std::shared_ptr<const FileInfo>& file, int size) {
+    if(!file->canThumbnail()) {
+        return QImage();
+    }
+    return memoryCache()->find(thumbnailUri(file).get(), size, file->mtime(), file->size(), false);
+}
+
 bool ThumbnailJob::isSupportedImageType(const std::shared_ptr<const MimeType>& mimeType) const {
     if(mimeType->isImage()) {
         auto supportedTypes = QImageReader::supportedMimeTypes();
@@ -136,19 +570,8 @@ bool ThumbnailJob::isThumbnailOutdated(const std::shared_ptr<const FileInfo>& fi
     return (thumb_mtime.isEmpty() || thumb_mtime.toULongLong() != file->mtime());
 }
 
-bool ThumbnailJob::readJpegExif(GInputStream *stream, QImage& thumbnail, QMatrix& matrix) {
-    /* try to extract thumbnails embedded in jpeg files */
-    ExifLoader* exif_loader = exif_loader_new();
-    while(!isCancelled()) {
-        unsigned char buf[4096];
-        gssize read_size = g_input_stream_read(stream, buf, 4096, cancellable_.get(), nullptr);
-        if(read_size <= 0) { // EOF or error
-            break;
-        }
-        if(exif_loader_write(exif_loader, buf, read_size) == 0) {
-            break;    // no more EXIF data
-        }
-    }
+// gets the orientation and the embedded thumbnail of a JPEG file from its EXIF data
+static bool loadJpegExif(ExifLoader* exif_loader, QImage& thumbnail, QMatrix& matrix) {
     ExifData* exif_data = exif_loader_get_data(exif_loader);
     exif_loader_unref(exif_loader);
     if(exif_data) {
@@ -197,31 +620,99 @@ bool ThumbnailJob::readJpegExif(GInputStream *stream, QImage& thumbnail, QMatrix
     return !thumbnail.isNull();
 }
 
+bool ThumbnailJob::readJpegExif(GInputStream *stream, QImage& thumbnail, QMatrix& matrix) {
+    /* try to extract thumbnails embedded in jpeg files */
+    ExifLoader* exif_loader = exif_loader_new();
+    while(!isCancelled()) {
+        unsigned char buf[4096];
+        gssize read_size = g_input_stream_read(stream, buf, 4096, cancellable_.get(), nullptr);
+        if(read_size <= 0) { // EOF or error
+            break;
+        }
+        if(exif_loader_write(exif_loader, buf, read_size) == 0) {
+            break;    // no more EXIF data
+        }
+    }
+    return loadJpegExif(exif_loader, thumbnail, matrix);
+}
+
+bool ThumbnailJob::readJpegExif(const unsigned char* data, size_t len, QImage& thumbnail, QMatrix& matrix) {
+    ExifLoader* exif_loader = exif_loader_new();
+    // NOTE: libexif only copies the EXIF data from the buffer, which it does not modify
+    exif_loader_write(exif_loader, const_cast<unsigned char*>(data), std::min(len, size_t(UINT_MAX)));
+    return loadJpegExif(exif_loader, thumbnail, matrix);
+}
+
 QImage ThumbnailJob::generateThumbnail(const std::shared_ptr<const FileInfo>& file, const FilePath& origPath, const char* uri, const QString& thumbnailFilename) {
     QImage result;
     auto mime_type = file->mimeType();
     if(isSupportedImageType(mime_type)) {
-        GFileInputStreamPtr ins{g_file_read(origPath.gfile().get(), cancellable_.get(), nullptr), false};
-        if(!ins)
-            return QImage();
         bool fromExif = false;
         QMatrix matrix;
-        if(strcmp(mime_type->name(), "image/jpeg") == 0) { // if this is a jpeg file
-            // try to get the thumbnail embedded in EXIF data
-            if(readJpegExif(G_INPUT_STREAM(ins.get()), result, matrix)) {
+        const bool isJpeg = strcmp(mime_type->name(), "image/jpeg") == 0;
+        int target_size = size_ > 128 ? 256 : 128;
+
+        // A local file is mapped into memory, and its EXIF data and image are read from the
+        // mapping. It is not mapped if the concurrent reads are limited, since the pages of the
+        // mapping are read while the image is decoded.
+        // NOTE: Reading a page of a mapping beyond the end of a file that has been truncated, or
+        // that cannot be read anymore, raises SIGBUS, which kills the process. It is not handled,
+        // since a signal handler cannot recover a decoder safely. That is why mappings are only
+        // used if the application enables them (see setUseMappedFiles()). Even then, the files of
+        // remote and FUSE file systems (where a lost connection or an I/O error raises SIGBUS) are
+        // never mapped, and nor are the files that may still be written: files changed in the last
+        // minMappedFileAge seconds (like downloads or images saved by an editor) and files whose
+        // size is not the listed one. Those are read through streams.
+        MappedFilePtr mappedFile;
+        size_t len = 0;
+        if(useMappedFiles_ && origPath.isNative() && file->size() < INT_MAX && maxConcurrentReads() == 0
+           && isLocalFileSystem(origPath)) {
+            auto localPath = origPath.localPath();
+            GStatBuf statBuf;
+            const qint64 now = QDateTime::currentMSecsSinceEpoch() / 1000;
+            if(g_stat(localPath.get(), &statBuf) == 0 && quint64(statBuf.st_size) == file->size()
+               && now - qint64(statBuf.st_mtime) >= minMappedFileAge) {
+                mappedFile = MappedFilePtr{g_mapped_file_new(localPath.get(), FALSE, nullptr)};
+            }
+            if(mappedFile) {
+                len = g_mapped_file_get_length(mappedFile.get());
+                if(len != file->size() || len > size_t(INT_MAX)) { // the file is changed meanwhile
+                    mappedFile.reset();
+                }
+            }
+        }
+        if(mappedFile) {
+            auto data = reinterpret_cast<const unsigned char*>(g_mapped_file_get_contents(mappedFile.get()));
+            if(isJpeg && readJpegExif(data, len, result, matrix)) { // try the thumbnail embedded in EXIF data
                 fromExif = true;
             }
+            if(!fromExif && !isCancelled()) {
+                result = readImageFromData(data, len, target_size);
+            }
+            mappedFile.reset();
         }
-        if(!fromExif) {  // not able to generate a thumbnail from the EXIF data
-            // load the original file and do the scaling ourselves
-            g_seekable_seek(G_SEEKABLE(ins.get()), 0, G_SEEK_SET, cancellable_.get(), nullptr);
-            result = readImageFromStream(G_INPUT_STREAM(ins.get()), file->size());
+        else { // the file is not local, is being written, or cannot be mapped
+            std::unique_ptr<ReadLocker> readLock{new ReadLocker{readLimiter()}};
+            GFileInputStreamPtr ins{g_file_read(origPath.gfile().get(), cancellable_.get(), nullptr), false};
+            if(!ins)
+                return QImage();
+            if(isJpeg) { // if this is a jpeg file
+                // try to get the thumbnail embedded in EXIF data
+                if(readJpegExif(G_INPUT_STREAM(ins.get()), result, matrix)) {
+                    fromExif = true;
+                }
+            }
+            readLock.reset(); // the image file is read again below only if needed
+            if(!fromExif) {  // not able to generate a thumbnail from the EXIF data
+                // load the original file and do the scaling ourselves
+                g_seekable_seek(G_SEEKABLE(ins.get()), 0, G_SEEK_SET, cancellable_.get(), nullptr);
+                result = readImageFromStream(G_INPUT_STREAM(ins.get()), file->size(), target_size);
+            }
+            g_input_stream_close(G_INPUT_STREAM(ins.get()), nullptr, nullptr);
         }
-        g_input_stream_close(G_INPUT_STREAM(ins.get()), nullptr, nullptr);
 
         if(!result.isNull()) { // the image is successfully loaded
             // scale the image as needed
-            int target_size = size_ > 128 ? 256 : 128;
 
             // only scale the original image if it's too large
             if(result.width() > target_size || result.height() > target_size) {
@@ -236,7 +727,7 @@ QImage ThumbnailJob::generateThumbnail(const std::shared_ptr<const FileInfo>& fi
             if(!fromExif) {
                 result.setText(QStringLiteral("Thumb::MTime"), QString::number(file->mtime()));
                 result.setText(QStringLiteral("Thumb::URI"), QString::fromUtf8(uri));
-                result.save(thumbnailFilename, "PNG");
+                saveThumbnail(result, thumbnailFilename);
             }
             // qDebug() << "save thumbnail:" << thumbnailFilename;
         }
@@ -244,9 +735,17 @@ QImage ThumbnailJob::generateThumbnail(const std::shared_ptr<const FileInfo>& fi
     else { // the image format is not supported, try to find an external thumbnailer
         // try all available external thumbnailers for it until sucess
         int target_size = size_ > 128 ? 256 : 128;
+        // The thumbnailer writes a temporary file in the same directory, which is renamed into
+        // place when it is complete, so that other threads or processes never read a partial file.
+        QTemporaryFile tempFile{thumbnailFilename + QStringLiteral(".XXXXXX.png")};
+        if(!tempFile.open()) {
+            return result;
+        }
+        tempFile.close();
+        const QString tempFilename = tempFile.fileName();
         file->mimeType()->forEachThumbnailer([&](const std::shared_ptr<const Thumbnailer>& thumbnailer) {
-            if(thumbnailer->run(uri, thumbnailFilename.toLocal8Bit().constData(), target_size)) {
-                result = QImage(thumbnailFilename);
+            if(thumbnailer->run(uri, tempFilename.toLocal8Bit().constData(), target_size)) {
+                result = QImage(tempFilename);
             }
             return !result.isNull(); // return true on success, and forEachThumbnailer() will stop.
         });
@@ -265,21 +764,66 @@ QImage ThumbnailJob::generateThumbnail(const std::shared_ptr<const FileInfo>& fi
             }
             if(Q_UNLIKELY(changed)) {
                 // save the modified PNG file containing metadata to a file.
-                result.save(thumbnailFilename, "PNG");
+                saveThumbnail(result, thumbnailFilename);
+            }
+            else if(g_rename(tempFilename.toLocal8Bit().constData(), thumbnailFilename.toLocal8Bit().constData()) == 0) {
+                tempFile.setAutoRemove(false); // it is the thumbnail file now
             }
         }
     }
     return result;
 }
 
+// Writes the thumbnail to a temporary file in the same directory, and renames it into place, as
+// the thumbnail specification requires, so that a partial file is never read.
+bool ThumbnailJob::saveThumbnail(const QImage& thumbnail, const QString& filename) {
+    QSaveFile file{filename};
+    if(!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    if(!thumbnail.save(&file, "PNG")) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
 QThreadPool* ThumbnailJob::threadPool() {
     if(Q_UNLIKELY(threadPool_ == nullptr)) {
         threadPool_ = new QThreadPool();
-        threadPool_->setMaxThreadCount(1);
+        threadPool_->setMaxThreadCount(QThread::idealThreadCount());
     }
     return threadPool_;
 }
 
+void ThumbnailJob::setThreadCount(int count) {
+    threadPool()->setMaxThreadCount(count > 0 ? count : QThread::idealThreadCount());
+}
+
+int ThumbnailJob::threadCount() {
+    return threadPool()->maxThreadCount();
+}
+
+void ThumbnailJob::setMaxConcurrentReads(int count) {
+    readLimiter()->setLimit(count);
+}
+
+int ThumbnailJob::maxConcurrentReads() {
+    return readLimiter()->limit();
+}
+
+void ThumbnailJob::setMemoryCacheSize(size_t maxBytes) {
+    memoryCache()->setMaxBytes(maxBytes);
+}
+
+void ThumbnailJob::clearMemoryCache() {
+    memoryCache()->clear();
+}
+
+ThumbnailJob::MemoryCacheStats ThumbnailJob::memoryCacheStats() {
+    return memoryCache()->stats();
+}
+
 void ThumbnailJob::setLocalFilesOnly(bool value) {
     localFilesOnly_ = value;
     if(fm_config) {
@@ -287,6 +831,10 @@ void ThumbnailJob::setLocalFilesOnly(bool value) {
     }
 }
 
+void ThumbnailJob::setUseMappedFiles(bool value) {
+    useMappedFiles_ = value;
+}
+
 void ThumbnailJob::setMaxThumbnailFileSize(int size) {
     maxThumbnailFileSize_ = size;
     if(fm_config) {
@@ -6,6 +6,9 @@
 #include "gioptrs.h"
 #include "job.h"
 #include <QThreadPool>
+#include <atomic>
+
+class QIODevice;
 
 namespace Fm {
 
@@ -21,14 +24,63 @@ public:
         return size_;
     }
 
+    const FileInfoList& files() const {
+        return files_;
+    }
+
     static QThreadPool* threadPool();
 
+    // The number of the threads that make thumbnails (the number of cores by default).
+    // The threads of the pool that are idle help a job with its files.
+    static void setThreadCount(int count);
+
+    static int threadCount();
+
+    // The number of the threads that may read image files at once (0 for no limit), since
+    // reading many files in parallel can be slower than reading them in turn on rotating disks.
+    // Decoding and scaling the images are not limited.
+    static void setMaxConcurrentReads(int count);
+
+    static int maxConcurrentReads();
+
+    // The recently loaded thumbnails are kept in memory, up to maxBytes in total (64 MiB by
+    // default, and 0 disables the cache), and shared by all the jobs. A thumbnail is reused
+    // before reading any file, as long as its file has the same URI, modification time and size.
+    static void setMemoryCacheSize(size_t maxBytes);
+
+    static void clearMemoryCache();
+
+    struct MemoryCacheStats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t thumbnails = 0;
+        size_t bytes = 0;
+    };
+
+    static MemoryCacheStats memoryCacheStats();
+
+    // the thumbnail of the file in the memory cache, or a null image
+    // (not counted in memoryCacheStats(), which only counts the lookups of the jobs)
+    static QImage cachedThumbnail(const std::shared_ptr<const FileInfo>& file, int size);
+
     static void setLocalFilesOnly(bool value);
 
     static bool localFilesOnly() {
         return localFilesOnly_;
     }
 
+    // Whether local image files are mapped into memory to be read (false by default).
+    // WARNING: A mapped file that is truncated, or that cannot be read anymore, while it is
+    // decoded raises SIGBUS and kills the process (see generateThumbnail()). So, mappings
+    // are opt-in, and even then the files of remote or FUSE file systems, the files modified
+    // recently, and all files if the concurrent reads are limited are read through streams.
+    static void setUseMappedFiles(bool value);
+
+    static bool useMappedFiles() {
+        return useMappedFiles_;
+    }
+
     static int maxThumbnailFileSize() {
         return maxThumbnailFileSize_;
     }
@@ -54,22 +106,40 @@ private:
 
     QImage generateThumbnail(const std::shared_ptr<const FileInfo>& file, const FilePath& origPath, const char* uri, const QString& thumbnailFilename);
 
-    QImage readImageFromStream(GInputStream* stream, size_t len);
+    // the file is decoded while it is read
+    QImage readImageFromStream(GInputStream* stream, size_t len, int targetSize);
+
+    static bool isLocalFileSystem(const FilePath& path);
+
+    static bool saveThumbnail(const QImage& thumbnail, const QString& filename);
 
-    QImage loadForFile(const std::shared_ptr<const FileInfo>& file);
+    // decodes a mapped file
+    QImage readImageFromData(const unsigned char* data, size_t len, int targetSize);
+
+    // decodes the image at about twice targetSize if the format allows it
+    QImage readImage(QIODevice* device, int targetSize);
+
+    QImage loadForFile(const std::shared_ptr<const FileInfo>& file, GChecksum* md5Calc);
+
+    static CStrPtr thumbnailUri(const std::shared_ptr<const FileInfo>& file);
+
+    void loadFiles();
 
     bool readJpegExif(GInputStream* stream, QImage& thumbnail, QMatrix& matrix);
 
+    bool readJpegExif(const unsigned char* data, size_t len, QImage& thumbnail, QMatrix& matrix);
+
 private:
     FileInfoList files_;
     int size_;
     std::vector<QImage> results_;
     GCancellablePtr cancellable_;
-    GChecksum* md5Calc_;
+    std::atomic<size_t> nextFile_; // the index of the next file to be loaded by a thread
 
     static QThreadPool* threadPool_;
 
     static bool localFilesOnly_;
+    static bool useMappedFiles_;
     static int maxThumbnailFileSize_;
 };
 
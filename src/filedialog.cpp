@@ -733,7 +733,7 @@ void FileDialog::selectNameFilter(const QString& filter) {
         }
 
         modelFilter_.update();
-        proxyModel_->invalidate();
+        proxyModel_->updateFilters();
         Q_EMIT filterSelected(filter);
     }
 }
@@ -806,7 +806,11 @@ void FileDialog::setFileMode(QFileDialog::FileMode mode) {
         // directly only is deprecated and not allowed.
         mode = QFileDialog::Directory;
     }
-    fileMode_ = mode;
+    if(mode != fileMode_) {
+        fileMode_ = mode;
+        // the filter shows only directories in the directory mode
+        proxyModel_->updateFilters();
+    }
 
     // enable multiple selection?
     updateSelectionMode();
@@ -1049,6 +1053,8 @@ void FileDialog::FileDialogFilter::update() {
         patterns_.emplace_back(QRegularExpression(QStringLiteral("\\A(?:")
                                                     + QRegularExpression::wildcardToRegularExpression(glob)
                                                     + QStringLiteral(")\\z"), QRegularExpression::CaseInsensitiveOption));
+        // compile the pattern now, rather than in the threads that may filter the files
+        patterns_.back().optimize();
 #else
         patterns_.emplace_back(QRegExp(glob, Qt::CaseInsensitive, QRegExp::Wildcard));
 #endif
@@ -151,6 +151,14 @@ private:
     public:
         FileDialogFilter(FileDialog* dlg): dlg_{dlg} {}
         bool filterAcceptsRow(const ProxyFolderModel* /*model*/, const std::shared_ptr<const Fm::FileInfo>& info) const override;
+        bool isThreadSafe() const override {
+            // QRegExp keeps the state of the last match, but QRegularExpression does not
+#if (QT_VERSION >= QT_VERSION_CHECK(5,12,0))
+            return true;
+#else
+            return false;
+#endif
+        }
         void update();
 
         FileDialog* dlg_;
@@ -0,0 +1,227 @@
+#include "filenameindex.h"
+#include "foldermodelitem.h"
+
+namespace Fm {
+
+// the lists of ids are rebuilt when they have at least this many removed ids
+static const size_t minStaleIds = 4096;
+
+static inline quint64 trigramAt(const QString& text, int i) {
+    return (quint64(text[i].unicode()) << 32) | (quint64(text[i + 1].unicode()) << 16) | quint64(text[i + 2].unicode());
+}
+
+FileNameIndex::FileNameIndex():
+    postingSize_{0},
+    staleIds_{0},
+    matchCount_{0} {
+}
+
+FileNameIndex::~FileNameIndex() {
+}
+
+void FileNameIndex::addItem(const FolderModelItem* item) {
+    auto it = ids_.find(item);
+    if(it != ids_.end()) {
+        Entry& entry = entries_[it->second];
+        entry.seen = true;
+        if(entry.info == item->info) {
+            return;
+        }
+        // the file is replaced, and it may be renamed
+        freeEntry(it->second);
+        ids_.erase(it);
+    }
+
+    quint32 id;
+    if(freeIds_.empty()) {
+        id = entries_.size();
+        entries_.emplace_back();
+    }
+    else {
+        id = freeIds_.back();
+        freeIds_.pop_back();
+    }
+    Entry& entry = entries_[id];
+    entry.item = item;
+    entry.info = item->info;
+    entry.name = item->info->displayName().toCaseFolded();
+    entry.matched = false;
+    entry.seen = true;
+    ids_.emplace(item, id);
+    addPostings(id);
+
+    if(!query_.isEmpty()) {
+        testEntry(id);
+        // the ids of removed entries are left in the results
+        if(results_.size() > 2 * matchCount_ + 1024) {
+            compactResults();
+        }
+    }
+}
+
+void FileNameIndex::removeItem(const FolderModelItem* item) {
+    auto it = ids_.find(item);
+    if(it != ids_.end()) {
+        freeEntry(it->second);
+        ids_.erase(it);
+    }
+}
+
+void FileNameIndex::syncItems(const std::vector<const FolderModelItem*>& items) {
+    for(auto& entry : entries_) {
+        entry.seen = false;
+    }
+    for(auto item : items) {
+        addItem(item);
+    }
+    for(quint32 id = 0; id < entries_.size(); ++id) {
+        if(entries_[id].item && !entries_[id].seen) {
+            removeItem(entries_[id].item);
+        }
+    }
+}
+
+void FileNameIndex::clear() {
+    entries_.clear();
+    freeIds_.clear();
+    ids_.clear();
+    postings_.clear();
+    postingSize_ = 0;
+    staleIds_ = 0;
+    results_.clear();
+    matchCount_ = 0;
+}
+
+bool FileNameIndex::setQuery(const QString& text) {
+    QString query = text.toCaseFolded();
+    if(query == query_) {
+        return false;
+    }
+    // a query that contains the last one can only match the names it matched
+    const bool narrowing = !query_.isEmpty() && query.contains(query_);
+
+    // the names that contain the query have all its trigrams, so the rarest one is looked for
+    static const std::vector<quint32> noIds;
+    const std::vector<quint32>* candidates = nullptr;
+    for(int i = 0; i + 3 <= query.length(); ++i) {
+        auto it = postings_.find(trigramAt(query, i));
+        if(it == postings_.cend()) {
+            candidates = &noIds;
+            break;
+        }
+        if(!candidates || it->second.size() < candidates->size()) {
+            candidates = &it->second;
+        }
+    }
+
+    std::vector<quint32> lastResults;
+    lastResults.swap(results_);
+    for(quint32 id : lastResults) {
+        entries_[id].matched = false;
+    }
+    matchCount_ = 0;
+    query_ = query;
+    if(query_.isEmpty()) {
+        return true;
+    }
+
+    if(narrowing && (!candidates || lastResults.size() <= candidates->size())) {
+        for(quint32 id : lastResults) {
+            testEntry(id);
+        }
+    }
+    else if(candidates) {
+        for(quint32 id : *candidates) {
+            testEntry(id);
+        }
+    }
+    else { // the query is too short to use the index
+        for(quint32 id = 0; id < entries_.size(); ++id) {
+            testEntry(id);
+        }
+    }
+    return true;
+}
+
+bool FileNameIndex::matches(const FolderModelItem* item) const {
+    if(query_.isEmpty()) {
+        return true;
+    }
+    auto it = ids_.find(item);
+    if(it == ids_.cend()) {
+        // the item is not indexed yet
+        return item->info->displayName().toCaseFolded().contains(query_);
+    }
+    return entries_[it->second].matched;
+}
+
+void FileNameIndex::addPostings(quint32 id) {
+    const QString& name = entries_[id].name;
+    for(int i = 0; i + 3 <= name.length(); ++i) {
+        auto& ids = postings_[trigramAt(name, i)];
+        // a trigram may occur more than once in the name
+        if(ids.empty() || ids.back() != id) {
+            ids.push_back(id);
+            ++postingSize_;
+        }
+    }
+}
+
+void FileNameIndex::freeEntry(quint32 id) {
+    Entry& entry = entries_[id];
+    if(entry.matched) {
+        --matchCount_;
+    }
+    if(entry.name.length() >= 3) {
+        staleIds_ += entry.name.length() - 2;
+    }
+    entry.item = nullptr;
+    entry.info.reset();
+    entry.name.clear();
+    entry.matched = false;
+    freeIds_.push_back(id);
+    // the id may be reused, which is harmless since candidates are always tested
+    if(staleIds_ >= minStaleIds && staleIds_ > postingSize_ / 2) {
+        rebuildPostings();
+    }
+}
+
+void FileNameIndex::rebuildPostings() {
+    postings_.clear();
+    postingSize_ = 0;
+    staleIds_ = 0;
+    for(quint32 id = 0; id < entries_.size(); ++id) {
+        if(entries_[id].item) {
+            addPostings(id);
+        }
+    }
+}
+
+void FileNameIndex::testEntry(quint32 id) {
+    Entry& entry = entries_[id];
+    // NOTE: an id may be tested twice, since the candidates are not unique
+    if(entry.item && !entry.matched && entry.name.contains(query_)) {
+        entry.matched = true;
+        ++matchCount_;
+        results_.push_back(id);
+    }
+}
+
+void FileNameIndex::compactResults() {
+    std::vector<quint32> results;
+    results.reserve(matchCount_);
+    for(quint32 id : results_) {
+        Entry& entry = entries_[id];
+        if(entry.matched) {
+            // the flag is unset for a while, so that an id is only kept once
+            entry.matched = false;
+            results.push_back(id);
+        }
+    }
+    for(quint32 id : results) {
+        entries_[id].matched = true;
+    }
+    results_.swap(results);
+}
+
+} // namespace Fm
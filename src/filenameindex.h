@@ -0,0 +1,91 @@
+// An incremental trigram index of the display names of the items of a FolderModel,
+// which finds the items whose names contain a text (case-insensitively) without testing
+// every name. Items are added and removed as the rows of the model change, and the result
+// of the last query is kept, so a query which extends it only tests the items it matched.
+
+#ifndef FM_FILENAMEINDEX_H
+#define FM_FILENAMEINDEX_H
+
+#include "libfmqtglobals.h"
+#include <QString>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "core/fileinfo.h"
+
+namespace Fm {
+
+class FolderModelItem;
+
+class LIBFM_QT_API FileNameIndex {
+public:
+    FileNameIndex();
+
+    ~FileNameIndex();
+
+    // adds the item, or indexes its name again if its file has been replaced
+    void addItem(const FolderModelItem* item);
+
+    void removeItem(const FolderModelItem* item);
+
+    // adds the items and removes the indexed items that are not among them
+    void syncItems(const std::vector<const FolderModelItem*>& items);
+
+    void clear();
+
+    size_t itemCount() const {
+        return ids_.size();
+    }
+
+    // finds the items whose display names contain the text; returns false if the query is not changed
+    bool setQuery(const QString& text);
+
+    // the case-folded query
+    const QString& query() const {
+        return query_;
+    }
+
+    // whether the display name of the item contains the query (all items match an empty query)
+    bool matches(const FolderModelItem* item) const;
+
+    size_t matchCount() const {
+        return matchCount_;
+    }
+
+private:
+    typedef quint64 Trigram;
+
+    struct Entry {
+        const FolderModelItem* item; // null if the entry is free
+        std::shared_ptr<const Fm::FileInfo> info; // the file whose name is indexed
+        QString name; // the case-folded display name
+        bool matched;
+        bool seen;
+    };
+
+    FileNameIndex(const FileNameIndex&) = delete;
+    FileNameIndex& operator=(const FileNameIndex&) = delete;
+
+    void addPostings(quint32 id);
+    void freeEntry(quint32 id);
+    void rebuildPostings();
+    void testEntry(quint32 id);
+    void compactResults();
+
+    std::vector<Entry> entries_;
+    std::vector<quint32> freeIds_;
+    std::unordered_map<const FolderModelItem*, quint32> ids_;
+    // The ids of the entries whose names have each trigram. The ids of removed entries are
+    // not removed from the lists at once; the candidates are always tested with their names.
+    std::unordered_map<Trigram, std::vector<quint32>> postings_;
+    size_t postingSize_; // the number of ids in the lists
+    size_t staleIds_; // the number of removed ids in the lists
+    QString query_;
+    std::vector<quint32> results_; // the ids of the matched entries (with removed ones)
+    size_t matchCount_;
+};
+
+}
+
+#endif // FM_FILENAMEINDEX_H
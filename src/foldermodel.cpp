@@ -35,10 +35,20 @@
 #include <QClipboard>
 #include "utilities.h"
 #include "fileoperation.h"
+#include "core/memoryusage_p.h"
+#include "foldermodelitemarena_p.h"
 
 namespace Fm {
 
+// removals of more separate ranges of rows than this are done with a layout change
+static const size_t maxRemovedRanges = 64;
+
+// the number of files per thumbnail job, which is small so that the files waiting for
+// their jobs can be reordered or dropped when the views are scrolled
+static const size_t thumbnailBatchSize = 4;
+
 FolderModel::FolderModel():
+    itemArena_{new FolderModelItemArena},
     hasPendingThumbnailHandler_{false},
     showFullNames_{false},
     isLoaded_{false} {
@@ -50,6 +60,9 @@ FolderModel::~FolderModel() {
     for(auto job: pendingThumbnailJobs_) {
         job->cancel();
     }
+    for(auto item : items) {
+        itemArena_->destroy(item);
+    }
 }
 
 void FolderModel::setFolder(const std::shared_ptr<Fm::Folder>& new_folder) {
@@ -88,17 +101,19 @@ void FolderModel::onFinishLoading() {
 
 void FolderModel::onFilesAdded(const Fm::FileInfoList& files) {
     int n_files = files.size();
-    beginInsertRows(QModelIndex(), items.count(), items.count() + n_files - 1);
+    int firstRow = items.size();
+    beginInsertRows(QModelIndex(), firstRow, firstRow + n_files - 1);
+    items.reserve(items.size() + n_files);
     for(auto& info : files) {
-        FolderModelItem item(info);
         /*
             if(fm_file_info_is_hidden(info)) {
               model->hiddenItems.append(item);
               continue;
             }
         */
-        items.append(item);
+        items.push_back(itemArena_->create(info));
     }
+    indexItems(firstRow);
     endInsertRows();
 
     if(isLoaded_) {
@@ -111,13 +126,12 @@ void FolderModel::onFilesChanged(std::vector<Fm::FileInfoPair>& files) {
         int row;
         auto& oldInfo = change.first;
         auto& newInfo = change.second;
-        QList<FolderModelItem>::iterator it = findItemByFileInfo(oldInfo.get(), &row);
-        if(it != items.end()) {
-            FolderModelItem& item = *it;
+        FolderModelItem* item = findItemByFileInfo(oldInfo.get(), &row);
+        if(item) {
             // try to update the item
-            item.info = newInfo;
-            item.thumbnails.clear();
-            QModelIndex index = createIndex(row, 0, &item);
+            setItemInfo(row, newInfo);
+            item->thumbnails.clear();
+            QModelIndex index = createIndex(row, 0, item);
             Q_EMIT dataChanged(index, index);
             if(oldInfo->size() != newInfo->size()) {
                 Q_EMIT fileSizeChanged(index);
@@ -131,38 +145,140 @@ void FolderModel::onCutFilesChanged(std::vector<Fm::FileInfoPair>& files) {
         int row;
         auto& oldInfo = change.first;
         auto& newInfo = change.second;
-        QList<FolderModelItem>::iterator it = findItemByFileInfo(oldInfo.get(), &row);
-        if(it != items.end()) {
-            FolderModelItem& item = *it;
-            item.info = newInfo;
+        if(findItemByFileInfo(oldInfo.get(), &row)) {
+            setItemInfo(row, newInfo);
         }
     }
     Q_EMIT dataChanged(index(0, 0), index(rowCount() - 1, 0)); // update all items
 }
 
 void FolderModel::onFilesRemoved(const Fm::FileInfoList& files) {
+    std::vector<int> rows;
+    rows.reserve(files.size());
     for(auto& info : files) {
         int row;
-        QList<FolderModelItem>::iterator it = findItemByName(info->name().c_str(), &row);
-        if(it != items.end()) {
-            beginRemoveRows(QModelIndex(), row, row);
-            items.erase(it);
+        // the removed file info is usually the one of the item
+        if(findItemByFileInfo(info.get(), &row) || findItemByName(info->name().c_str(), &row)) {
+            rows.push_back(row);
+        }
+    }
+    if(rows.empty()) {
+        return;
+    }
+
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    for(int row : rows) {
+        unindexItem(*items[row]);
+    }
+
+    // group the rows into contiguous ranges
+    std::vector<std::pair<int, int>> ranges;
+    for(int row : rows) {
+        if(!ranges.empty() && ranges.back().second == row - 1) {
+            ranges.back().second = row;
+        }
+        else {
+            ranges.emplace_back(row, row);
+        }
+    }
+
+    if(ranges.size() > maxRemovedRanges) {
+        // too many scattered rows; remove them all in a single layout change
+        // instead of making the proxy models and views remap their rows for each range
+        removeScatteredRows(rows);
+    }
+    else {
+        // remove the ranges from the bottom, so that the ranges to be removed are not shifted
+        for(auto it = ranges.crbegin(); it != ranges.crend(); ++it) {
+            beginRemoveRows(QModelIndex(), it->first, it->second);
+            auto first = items.begin() + it->first;
+            auto last = items.begin() + it->second + 1;
+            for(auto itemIt = first; itemIt != last; ++itemIt) {
+                forgetThumbnailPriorities(*itemIt);
+                itemArena_->destroy(*itemIt);
+            }
+            items.erase(first, last);
             endRemoveRows();
         }
     }
+    // update the indexes of the shifted rows only once
+    indexItems(rows.front());
+}
+
+// removes the given rows (sorted and unique) with a layout change
+void FolderModel::removeScatteredRows(const std::vector<int>& rows) {
+    Q_EMIT layoutAboutToBeChanged();
+
+    // compact the rows in place; the new row of each old row is kept, or -1 if it is removed
+    std::vector<int> newRows(items.size());
+    auto removedIt = rows.cbegin();
+    int newRow = 0;
+    for(int row = 0; row < int(items.size()); ++row) {
+        if(removedIt != rows.cend() && *removedIt == row) {
+            newRows[row] = -1;
+            forgetThumbnailPriorities(items[row]);
+            itemArena_->destroy(items[row]);
+            ++removedIt;
+        }
+        else {
+            newRows[row] = newRow;
+            items[newRow++] = items[row];
+        }
+    }
+    items.resize(newRow);
+
+    // the items are not moved, but the rows of the persistent indexes should be updated
+    const QModelIndexList oldIndexes = persistentIndexList();
+    QModelIndexList newIndexes;
+    newIndexes.reserve(oldIndexes.size());
+    for(const auto& oldIndex : oldIndexes) {
+        newRow = newRows[oldIndex.row()];
+        newIndexes.append(newRow >= 0 ? index(newRow, oldIndex.column()) : QModelIndex());
+    }
+    changePersistentIndexList(oldIndexes, newIndexes);
+
+    Q_EMIT layoutChanged();
 }
 
 void FolderModel::loadPendingThumbnails() {
     hasPendingThumbnailHandler_ = false;
+    // Only as many jobs are started as the threads can run (with one more for each thread,
+    // to keep it busy), and the other files wait here, in the order of their priorities.
+    const int maxJobs = 2 * Fm::ThumbnailJob::threadPool()->maxThreadCount();
+    int runningJobs = std::count_if(pendingThumbnailJobs_.cbegin(), pendingThumbnailJobs_.cend(), [](Fm::ThumbnailJob* job) {
+        return !job->isCancelled();
+    });
     for(auto& item: thumbnailData_) {
-        if(!item.pendingThumbnails_.empty()) {
-            auto job = new Fm::ThumbnailJob(std::move(item.pendingThumbnails_), item.size_);
+        auto& pending = item.pendingThumbnails_;
+        if(pending.empty() || runningJobs >= maxJobs) {
+            continue;
+        }
+        if(!thumbnailClients_.empty()) {
+            // the visible files first, then the prefetched ones, and then the others
+            const int size = item.size_;
+            auto prefetched = std::stable_partition(pending.begin(), pending.end(), [this, size](const std::shared_ptr<const Fm::FileInfo>& file) {
+                return thumbnailPriority(file.get(), size) == 0;
+            });
+            std::stable_partition(prefetched, pending.end(), [this, size](const std::shared_ptr<const Fm::FileInfo>& file) {
+                return thumbnailPriority(file.get(), size) == 1;
+            });
+        }
+        size_t first = 0;
+        while(first < pending.size() && runningJobs < maxJobs) {
+            size_t last = std::min(first + thumbnailBatchSize, pending.size());
+            Fm::FileInfoList files;
+            files.assign(pending.cbegin() + first, pending.cbegin() + last);
+            auto job = new Fm::ThumbnailJob(std::move(files), item.size_);
             pendingThumbnailJobs_.push_back(job);
             job->setAutoDelete(true);
             connect(job, &Fm::ThumbnailJob::thumbnailLoaded, this, &FolderModel::onThumbnailLoaded, Qt::BlockingQueuedConnection);
             connect(job, &Fm::ThumbnailJob::finished, this, &FolderModel::onThumbnailJobFinished, Qt::BlockingQueuedConnection);
             Fm::ThumbnailJob::threadPool()->start(job);
+            ++runningJobs;
+            first = last;
         }
+        pending.erase(pending.begin(), pending.begin() + first);
     }
 }
 
@@ -170,9 +286,126 @@ void FolderModel::queueLoadThumbnail(const std::shared_ptr<const Fm::FileInfo>&
     auto it = std::find_if(thumbnailData_.begin(), thumbnailData_.end(), [size](ThumbnailData& item){return item.size_ == size;});
     if(it != thumbnailData_.end()) {
         it->pendingThumbnails_.push_back(file);
-        if(!hasPendingThumbnailHandler_) {
-            QTimer::singleShot(0, this, &FolderModel::loadPendingThumbnails);
-            hasPendingThumbnailHandler_ = true;
+        scheduleThumbnails();
+    }
+}
+
+void FolderModel::scheduleThumbnails() {
+    if(!hasPendingThumbnailHandler_) {
+        QTimer::singleShot(0, this, &FolderModel::loadPendingThumbnails);
+        hasPendingThumbnailHandler_ = true;
+    }
+}
+
+void FolderModel::prioritizeThumbnails(const QObject* client, int size, const std::vector<int>& visibleRows, const std::vector<int>& prefetchedRows) {
+    if(visibleRows.empty() && prefetchedRows.empty()) {
+        thumbnailClients_.erase(client);
+        return;
+    }
+    auto& thumbnailClient = thumbnailClients_[client];
+    thumbnailClient.size = size;
+    auto& priorities = thumbnailClient.priorities;
+    priorities.clear();
+    for(int row : prefetchedRows) {
+        if(row >= 0 && row < int(items.size())) {
+            priorities[items[row]] = 1;
+        }
+    }
+    for(int row : visibleRows) {
+        if(row >= 0 && row < int(items.size())) {
+            priorities[items[row]] = 0;
+        }
+    }
+
+    // drop the queued thumbnails of the files that are not shown anymore
+    for(auto& item: thumbnailData_) {
+        if(!canDropThumbnails(item.size_)) {
+            continue;
+        }
+        const int itemSize = item.size_;
+        auto& pending = item.pendingThumbnails_;
+        auto it = std::stable_partition(pending.begin(), pending.end(), [this, itemSize](const std::shared_ptr<const Fm::FileInfo>& file) {
+            return thumbnailPriority(file.get(), itemSize) < 2;
+        });
+        for(auto dropped = it; dropped != pending.end(); ++dropped) {
+            unqueueThumbnail(dropped->get(), itemSize);
+        }
+        pending.erase(it, pending.end());
+    }
+    // and cancel the jobs that only load such thumbnails
+    for(auto job : pendingThumbnailJobs_) {
+        if(job->isCancelled() || !canDropThumbnails(job->size())) {
+            continue;
+        }
+        bool wanted = false;
+        for(const auto& file : job->files()) {
+            if(thumbnailPriority(file.get(), job->size()) < 2 && isThumbnailLoading(file.get(), job->size())) {
+                wanted = true;
+                break;
+            }
+        }
+        if(!wanted) {
+            job->cancel();
+        }
+    }
+    scheduleThumbnails();
+}
+
+// 0 for the files shown by a client of the size, 1 for the prefetched ones, and 2 for the others
+int FolderModel::thumbnailPriority(const Fm::FileInfo* file, int size) {
+    int row;
+    const FolderModelItem* item = findItemByFileInfo(file, &row);
+    int priority = 2;
+    if(item) {
+        for(const auto& client : thumbnailClients_) {
+            if(client.second.size != size) {
+                continue;
+            }
+            auto it = client.second.priorities.find(item);
+            if(it != client.second.priorities.cend()) {
+                priority = std::min(priority, it->second);
+            }
+        }
+    }
+    return priority;
+}
+
+// The thumbnails of a size may be dropped only if all the users of the size tell which rows they
+// show. A user that does not (like a view without prioritizeThumbnails()) may show any row.
+bool FolderModel::canDropThumbnails(int size) const {
+    auto data = std::find_if(thumbnailData_.cbegin(), thumbnailData_.cend(), [size](const ThumbnailData& item) {
+        return item.size_ == size;
+    });
+    if(data == thumbnailData_.cend()) {
+        return true; // nobody uses thumbnails of this size anymore
+    }
+    int clients = std::count_if(thumbnailClients_.cbegin(), thumbnailClients_.cend(), [size](const std::pair<const QObject* const, ThumbnailClient>& client) {
+        return client.second.size == size;
+    });
+    return clients >= data->refCount_;
+}
+
+// removes the item, which is going to be destroyed, from the rows shown by the clients
+void FolderModel::forgetThumbnailPriorities(const FolderModelItem* item) {
+    for(auto& client : thumbnailClients_) {
+        client.second.priorities.erase(item);
+    }
+}
+
+bool FolderModel::isThumbnailLoading(const Fm::FileInfo* file, int size) {
+    int row;
+    FolderModelItem* item = findItemByFileInfo(file, &row);
+    return item && item->findThumbnail(size, false)->status == FolderModelItem::ThumbnailLoading;
+}
+
+// lets the thumbnail be queued again when it is asked for
+void FolderModel::unqueueThumbnail(const Fm::FileInfo* file, int size) {
+    int row;
+    FolderModelItem* item = findItemByFileInfo(file, &row);
+    if(item) {
+        FolderModelItem::Thumbnail* thumbnail = item->findThumbnail(size, false);
+        if(thumbnail->status == FolderModelItem::ThumbnailLoading) {
+            thumbnail->status = FolderModelItem::ThumbnailNotChecked;
         }
     }
 }
@@ -180,10 +413,12 @@ void FolderModel::queueLoadThumbnail(const std::shared_ptr<const Fm::FileInfo>&
 void FolderModel::insertFiles(int row, const Fm::FileInfoList& files) {
     int n_files = files.size();
     beginInsertRows(QModelIndex(), row, row + n_files - 1);
+    int firstRow = items.size();
+    items.reserve(items.size() + n_files);
     for(auto& info : files) {
-        FolderModelItem item(info);
-        items.append(item);
+        items.push_back(itemArena_->create(info));
     }
+    indexItems(firstRow);
     endInsertRows();
 }
 
@@ -236,10 +471,60 @@ void FolderModel::removeAll() {
         return;
     }
     beginRemoveRows(QModelIndex(), 0, items.size() - 1);
+    for(auto item : items) {
+        itemArena_->destroy(item);
+    }
     items.clear();
+    items.shrink_to_fit();
+    rowsByInfo_.clear();
+    infosByName_.clear();
+    for(auto& client : thumbnailClients_) {
+        client.second.priorities.clear();
+    }
     endRemoveRows();
 }
 
+// replaces the file info of the item at the row and updates the indexes
+void FolderModel::setItemInfo(int row, const std::shared_ptr<const Fm::FileInfo>& info) {
+    FolderModelItem& item = *items[row];
+    unindexItem(item);
+    item.info = info;
+    rowsByInfo_[info.get()] = row;
+    indexName(info.get());
+}
+
+// (re)indexes the items from firstRow to the end
+void FolderModel::indexItems(int firstRow) {
+    for(int row = firstRow; row < int(items.size()); ++row) {
+        const Fm::FileInfo* info = items[row]->info.get();
+        rowsByInfo_[info] = row;
+        indexName(info);
+    }
+}
+
+// NOTE: files in virtual folders (like search:///) may have the same names, so all of them are indexed
+void FolderModel::indexName(const Fm::FileInfo* info) {
+    auto range = infosByName_.equal_range(&info->name());
+    for(auto it = range.first; it != range.second; ++it) {
+        if(it->second == info) { // already indexed
+            return;
+        }
+    }
+    infosByName_.emplace(&info->name(), info);
+}
+
+void FolderModel::unindexItem(const FolderModelItem& item) {
+    const Fm::FileInfo* info = item.info.get();
+    rowsByInfo_.erase(info);
+    auto range = infosByName_.equal_range(&info->name());
+    for(auto it = range.first; it != range.second; ++it) {
+        if(it->second == info) {
+            infosByName_.erase(it);
+            break;
+        }
+    }
+}
+
 int FolderModel::rowCount(const QModelIndex& parent) const {
     if(parent.isValid()) {
         return 0;
@@ -294,7 +579,7 @@ QString FolderModel::makeTooltip(FolderModelItem* item) const {
 }
 
 QVariant FolderModel::data(const QModelIndex& index, int role/* = Qt::DisplayRole*/) const {
-    if(!index.isValid() || index.row() > items.size() || index.column() >= NumOfColumns) {
+    if(!index.isValid() || index.row() >= int(items.size()) || index.column() >= NumOfColumns) {
         return QVariant();
     }
     FolderModelItem* item = itemFromIndex(index);
@@ -384,11 +669,10 @@ QVariant FolderModel::headerData(int section, Qt::Orientation orientation, int r
 }
 
 QModelIndex FolderModel::index(int row, int column, const QModelIndex& /*parent*/) const {
-    if(row < 0 || row >= items.size() || column < 0 || column >= NumOfColumns) {
+    if(row < 0 || row >= int(items.size()) || column < 0 || column >= NumOfColumns) {
         return QModelIndex();
     }
-    const FolderModelItem& item = items.at(row);
-    return createIndex(row, column, (void*)&item);
+    return createIndex(row, column, items[row]);
 }
 
 QModelIndex FolderModel::parent(const QModelIndex& /*index*/) const {
@@ -412,47 +696,51 @@ Qt::ItemFlags FolderModel::flags(const QModelIndex& index) const {
 }
 
 std::shared_ptr<const Fm::FileInfo> FolderModel::fileInfoFromPath(const Fm::FilePath& path) const {
-    QList<FolderModelItem>::const_iterator it = items.begin();
-    while(it != items.end()) {
-        const FolderModelItem& item = *it;
-        if(item.info->path() == path) {
-            return item.info;
+    if(folder_ && path.isNative() && folder_->path().isParentOf(path)) {
+        // the names of local files are their base names and are unique in the folder
+        const std::string name{path.baseName().get()};
+        auto range = infosByName_.equal_range(&name);
+        for(auto it = range.first; it != range.second; ++it) {
+            auto rowIt = rowsByInfo_.find(it->second);
+            if(rowIt != rowsByInfo_.end() && it->second->path() == path) {
+                return items[rowIt->second]->info;
+            }
+        }
+        return nullptr;
+    }
+    const unsigned int hash = path.hash();
+    for(const FolderModelItem* item : items) {
+        // compare the hashes first to avoid making a GFile for each item
+        if(item->info->pathHash() == hash && item->info->path() == path) {
+            return item->info;
         }
-        ++it;
     }
     return nullptr;
 }
 
-// FIXME: this is very inefficient and should be replaced with a
-// more reasonable implementation later.
-QList<FolderModelItem>::iterator FolderModel::findItemByName(const char* name, int* row) {
-    QList<FolderModelItem>::iterator it = items.begin();
-    int i = 0;
-    while(it != items.end()) {
-        FolderModelItem& item = *it;
-        if(item.info->name() == name) {
-            *row = i;
-            return it;
+FolderModelItem* FolderModel::findItemByName(const char* name, int* row) {
+    const std::string key{name};
+    // the item in the first row is found if several files have the name, as before
+    FolderModelItem* found = nullptr;
+    auto range = infosByName_.equal_range(&key);
+    for(auto it = range.first; it != range.second; ++it) {
+        int itemRow;
+        FolderModelItem* item = findItemByFileInfo(it->second, &itemRow);
+        if(item && (!found || itemRow < *row)) {
+            found = item;
+            *row = itemRow;
         }
-        ++it;
-        ++i;
     }
-    return items.end();
+    return found;
 }
 
-QList< FolderModelItem >::iterator FolderModel::findItemByFileInfo(const Fm::FileInfo* info, int* row) {
-    QList<FolderModelItem>::iterator it = items.begin();
-    int i = 0;
-    while(it != items.end()) {
-        FolderModelItem& item = *it;
-        if(item.info.get() == info) {
-            *row = i;
-            return it;
-        }
-        ++it;
-        ++i;
+FolderModelItem* FolderModel::findItemByFileInfo(const Fm::FileInfo* info, int* row) {
+    auto it = rowsByInfo_.find(info);
+    if(it == rowsByInfo_.end()) {
+        return nullptr;
     }
-    return items.end();
+    *row = it->second;
+    return items[it->second];
 }
 
 QStringList FolderModel::mimeTypes() const {
@@ -601,10 +889,8 @@ void FolderModel::releaseThumbnails(int size) {
             }
 
             // remove all cached thumbnails of the specified size
-            QList<FolderModelItem>::iterator itemIt;
-            for(itemIt = items.begin(); itemIt != items.end(); ++itemIt) {
-                FolderModelItem& item = *itemIt;
-                item.removeThumbnail(size);
+            for(auto item : items) {
+                item->removeThumbnail(size);
             }
             break;
         }
@@ -618,18 +904,25 @@ void FolderModel::onThumbnailJobFinished() {
     if(it != pendingThumbnailJobs_.end()) {
         pendingThumbnailJobs_.erase(it);
     }
+    if(job->isCancelled()) {
+        // the files that are not loaded by the cancelled job
+        for(const auto& file : job->files()) {
+            unqueueThumbnail(file.get(), job->size());
+        }
+    }
+    // start the jobs of the waiting files
+    scheduleThumbnails();
 }
 
 void FolderModel::onThumbnailLoaded(const std::shared_ptr<const Fm::FileInfo>& file, int size, const QImage& image) {
     // find the model item this thumbnail belongs to
     int row;
-    QList<FolderModelItem>::iterator it = findItemByFileInfo(file.get(), &row);
-    if(it != items.end()) {
+    FolderModelItem* item = findItemByFileInfo(file.get(), &row);
+    if(item) {
         // the file is found in our model
-        FolderModelItem& item = *it;
-        QModelIndex index = createIndex(row, 0, (void*)&item);
+        QModelIndex index = createIndex(row, 0, item);
         // store the image in the folder model item.
-        FolderModelItem::Thumbnail* thumbnail = item.findThumbnail(size, false);
+        FolderModelItem::Thumbnail* thumbnail = item->findThumbnail(size, false);
         thumbnail->image = image;
         thumbnail->transparent = false;
         // qDebug("thumbnail loaded for: %s, size: %d", item.displayName.toUtf8().constData(), size);
@@ -655,6 +948,15 @@ QImage FolderModel::thumbnailFromIndex(const QModelIndex& index, int size) {
         // qDebug("FolderModel::thumbnailFromIndex: %d, %s", thumbnail->status, item->displayName.toUtf8().data());
         switch(thumbnail->status) {
         case FolderModelItem::ThumbnailNotChecked: {
+            // the thumbnail may have been loaded recently (e.g., by another model of the folder)
+            QImage image = Fm::ThumbnailJob::cachedThumbnail(item->info, size);
+            if(!image.isNull()) {
+                thumbnail->image = image;
+                thumbnail->transparent = false;
+                thumbnail->status = FolderModelItem::ThumbnailLoaded;
+                // findThumbnail() makes a transparent copy for a cut file
+                return item->findThumbnail(size, item->isCut())->image;
+            }
             // load the thumbnail
             queueLoadThumbnail(item->info, size);
             thumbnail->status = FolderModelItem::ThumbnailLoading;
@@ -669,5 +971,29 @@ QImage FolderModel::thumbnailFromIndex(const QModelIndex& index, int size) {
     return QImage();
 }
 
+FolderModel::MemoryUsage FolderModel::memoryUsage() const {
+    MemoryUsage usage;
+    // the rows are pointers to the items in the arena
+    usage.items = items.capacity() * sizeof(void*) + itemArena_->capacityInBytes();
+    // the nodes and buckets of the indexes
+    usage.items += rowsByInfo_.size() * (sizeof(void*) * 2 + sizeof(std::pair<const Fm::FileInfo*, int>))
+                   + rowsByInfo_.bucket_count() * sizeof(void*);
+    usage.items += infosByName_.size() * (sizeof(void*) * 2 + sizeof(std::pair<const std::string*, const Fm::FileInfo*>))
+                   + infosByName_.bucket_count() * sizeof(void*);
+    for(const FolderModelItem* item: items) {
+        usage.displayStrings += stringMemory(item->dispMtime_) + stringMemory(item->dispDtime_) + stringMemory(item->dispSize_);
+        usage.items += item->thumbnails.capacity() * sizeof(FolderModelItem::Thumbnail);
+        for(const auto& thumbnail: item->thumbnails) {
+            if(!thumbnail.image.isNull()) {
+#if (QT_VERSION >= QT_VERSION_CHECK(5,10,0))
+                usage.thumbnails += thumbnail.image.sizeInBytes();
+#else
+                usage.thumbnails += thumbnail.image.byteCount();
+#endif
+            }
+        }
+    }
+    return usage;
+}
 
 } // namespace Fm
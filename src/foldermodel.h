@@ -27,9 +27,11 @@
 #include <QIcon>
 #include <QImage>
 #include <QList>
+#include <memory>
 #include <vector>
 #include <utility>
 #include <forward_list>
+#include <unordered_map>
 #include "foldermodelitem.h"
 
 #include "core/folder.h"
@@ -37,6 +39,8 @@
 
 namespace Fm {
 
+class FolderModelItemArena;
+
 class LIBFM_QT_API FolderModel : public QAbstractListModel {
     Q_OBJECT
 public:
@@ -95,10 +99,34 @@ public:
     void cacheThumbnails(int size);
     void releaseThumbnails(int size);
 
+    // Tells which rows a client (like a view) that shows thumbnails of the size shows, and which rows
+    // it may show soon, so that their thumbnails are loaded first. If every user of the size (see
+    // cacheThumbnails()) is such a client, the queued thumbnails of the rows that none of them shows or
+    // may show are dropped, and are queued again when they are asked for. Otherwise, all are kept.
+    // Empty lists remove the client.
+    void prioritizeThumbnails(const QObject* client, int size, const std::vector<int>& visibleRows, const std::vector<int>& prefetchedRows);
+
     void setShowFullName(bool fullName) {
         showFullNames_ = fullName;
     }
 
+    bool showFullNames() const {
+        return showFullNames_;
+    }
+
+    // the memory taken by the items of the model, in bytes (see also Folder::memoryUsage())
+    struct MemoryUsage {
+        size_t items = 0;
+        size_t displayStrings = 0; // cached strings of modification times, deletion times and sizes
+        size_t thumbnails = 0;
+
+        size_t total() const {
+            return items + displayStrings + thumbnails;
+        }
+    };
+
+    MemoryUsage memoryUsage() const;
+
 Q_SIGNALS:
     void thumbnailLoaded(const QModelIndex& index, int size);
     void fileSizeChanged(const QModelIndex& index);
@@ -123,12 +151,23 @@ protected:
     void queueLoadThumbnail(const std::shared_ptr<const Fm::FileInfo>& file, int size);
     void insertFiles(int row, const Fm::FileInfoList& files);
     void removeAll();
-    QList<FolderModelItem>::iterator findItemByName(const char* name, int* row);
-    QList<FolderModelItem>::iterator findItemByFileInfo(const Fm::FileInfo* info, int* row);
+    void removeScatteredRows(const std::vector<int>& rows);
+    FolderModelItem* findItemByName(const char* name, int* row);
+    FolderModelItem* findItemByFileInfo(const Fm::FileInfo* info, int* row);
 
 private:
+    void scheduleThumbnails();
+    int thumbnailPriority(const Fm::FileInfo* file, int size);
+    bool canDropThumbnails(int size) const;
+    void forgetThumbnailPriorities(const FolderModelItem* item);
+    bool isThumbnailLoading(const Fm::FileInfo* file, int size);
+    void unqueueThumbnail(const Fm::FileInfo* file, int size);
     void setCutFiles(const Fm::FilePathList& paths);
     QString makeTooltip(FolderModelItem* item) const;
+    void setItemInfo(int row, const std::shared_ptr<const Fm::FileInfo>& info);
+    void indexItems(int firstRow);
+    void indexName(const Fm::FileInfo* info);
+    void unindexItem(const FolderModelItem& item);
 
 private:
 
@@ -143,11 +182,34 @@ private:
         Fm::FileInfoList pendingThumbnails_;
     };
 
+    // hashes the name strings owned by the file infos of the items
+    struct NameHash {
+        size_t operator()(const std::string* name) const {
+            return std::hash<std::string>{}(*name);
+        }
+    };
+    struct NameEqual {
+        bool operator()(const std::string* a, const std::string* b) const {
+            return *a == *b;
+        }
+    };
+
     std::shared_ptr<Fm::Folder> folder_;
-    QList<FolderModelItem> items;
+    std::unique_ptr<FolderModelItemArena> itemArena_;
+    std::vector<FolderModelItem*> items; // the items of the rows, which are stored in itemArena_
+
+    // indexes of the items, to find them without scanning the whole list (see indexItems())
+    std::unordered_map<const Fm::FileInfo*, int> rowsByInfo_;
+    std::unordered_multimap<const std::string*, const Fm::FileInfo*, NameHash, NameEqual> infosByName_;
 
     bool hasPendingThumbnailHandler_;
     std::vector<Fm::ThumbnailJob*> pendingThumbnailJobs_;
+    // the rows shown by a client, with the size of its thumbnails (see prioritizeThumbnails())
+    struct ThumbnailClient {
+        int size;
+        std::unordered_map<const FolderModelItem*, int> priorities; // 0 if shown, 1 if prefetched
+    };
+    std::unordered_map<const QObject*, ThumbnailClient> thumbnailClients_;
     std::forward_list<ThumbnailData> thumbnailData_;
 
     bool showFullNames_;
@@ -0,0 +1,51 @@
+#include "foldermodelitemarena_p.h"
+#include <new>
+
+namespace Fm {
+
+FolderModelItemArena::FolderModelItemArena(size_t blockSize):
+    freeSlots_{nullptr},
+    blockSize_{blockSize},
+    size_{0} {
+}
+
+FolderModelItemArena::~FolderModelItemArena() {
+    // NOTE: the items should have been destroyed by their owner, which knows where they are.
+    Q_ASSERT(size_ == 0);
+}
+
+FolderModelItem* FolderModelItemArena::create(const std::shared_ptr<const Fm::FileInfo>& info) {
+    if(!freeSlots_) {
+        addBlock();
+    }
+    Slot* slot = freeSlots_;
+    freeSlots_ = slot->nextFree;
+    ++size_;
+    return new(&slot->item) FolderModelItem(info);
+}
+
+void FolderModelItemArena::destroy(FolderModelItem* item) {
+    item->~FolderModelItem();
+    --size_;
+    if(size_ == 0) {
+        // all the items are gone; release the memory (e.g., when the folder is reloaded)
+        blocks_.clear();
+        freeSlots_ = nullptr;
+        return;
+    }
+    Slot* slot = reinterpret_cast<Slot*>(item);
+    slot->nextFree = freeSlots_;
+    freeSlots_ = slot;
+}
+
+void FolderModelItemArena::addBlock() {
+    std::unique_ptr<Slot[]> block{new Slot[blockSize_]};
+    // link the slots in the order of their addresses, so that new items are allocated contiguously
+    for(size_t i = 0; i < blockSize_; ++i) {
+        block[i].nextFree = i + 1 < blockSize_ ? &block[i + 1] : freeSlots_;
+    }
+    freeSlots_ = &block[0];
+    blocks_.push_back(std::move(block));
+}
+
+} // namespace Fm
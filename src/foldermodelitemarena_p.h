@@ -0,0 +1,56 @@
+// An arena of FolderModelItem objects, which are allocated in blocks.
+// The items never move, so their addresses can be used as the internal pointers of
+// model indexes while the rows of the model only hold pointers to them.
+// NOTE: This is an internal part of FolderModel, and not a part of the API.
+
+#ifndef FM_FOLDERMODELITEMARENA_P_H
+#define FM_FOLDERMODELITEMARENA_P_H
+
+#include <memory>
+#include <vector>
+#include <type_traits>
+#include "foldermodelitem.h"
+
+namespace Fm {
+
+class FolderModelItemArena {
+public:
+    explicit FolderModelItemArena(size_t blockSize = 256);
+
+    ~FolderModelItemArena();
+
+    // makes a new item in a free slot
+    FolderModelItem* create(const std::shared_ptr<const Fm::FileInfo>& info);
+
+    // destroys the item and frees its slot for reuse; the blocks are released with the last item
+    void destroy(FolderModelItem* item);
+
+    size_t size() const {
+        return size_;
+    }
+
+    // the memory taken by the blocks, in bytes
+    size_t capacityInBytes() const {
+        return blocks_.size() * blockSize_ * sizeof(Slot);
+    }
+
+private:
+    union Slot {
+        typename std::aligned_storage<sizeof(FolderModelItem), alignof(FolderModelItem)>::type item;
+        Slot* nextFree;
+    };
+
+    FolderModelItemArena(const FolderModelItemArena&) = delete;
+    FolderModelItemArena& operator=(const FolderModelItemArena&) = delete;
+
+    void addBlock();
+
+    std::vector<std::unique_ptr<Slot[]>> blocks_;
+    Slot* freeSlots_; // the free slots, linked through Slot::nextFree
+    size_t blockSize_;
+    size_t size_;
+};
+
+}
+
+#endif // FM_FOLDERMODELITEMARENA_P_H
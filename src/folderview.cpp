@@ -854,6 +854,7 @@ FolderView::FolderView(FolderView::ViewMode _mode, QWidget *parent):
     itemDelegateMargins_(QSize(3, 3)),
     shadowHidden_(false),
     ctrlRightClick_(false),
+    hasPendingThumbnailPriorities_(false),
     smoothScrollTimer_(nullptr) {
 
     iconSize_[IconMode - FirstViewMode] = QSize(48, 48);
@@ -978,7 +979,7 @@ void FolderView::onClosingEditor(QWidget* editor, QAbstractItemDelegate::EndEdit
         auto info = data.value<std::shared_ptr<const Fm::FileInfo>>();
         if (info) {
             // NOTE: "Edit name" is used to handle invalid filename encoding.
-            auto oldName = QString::fromUtf8(g_file_info_get_edit_name(info->gFileInfo().get()));
+            auto oldName = info->editName();
             if(oldName.isEmpty()) {
                 oldName = QString::fromStdString(info->name());
             }
@@ -1137,6 +1138,13 @@ void FolderView::setViewMode(ViewMode _mode) {
         // inline renaming
         connect(delegate, &QAbstractItemDelegate::closeEditor, this, &FolderView::onClosingEditor);
 
+        // the thumbnails of the visible items are loaded first
+        for(QScrollBar* sbar : {view->verticalScrollBar(), view->horizontalScrollBar()}) {
+            connect(sbar, &QAbstractSlider::valueChanged, this, &FolderView::queueThumbnailPriorities, Qt::UniqueConnection);
+            connect(sbar, &QAbstractSlider::rangeChanged, this, &FolderView::queueThumbnailPriorities, Qt::UniqueConnection);
+        }
+        queueThumbnailPriorities();
+
         if(model_) {
             // FIXME: preserve selections
             model_->setThumbnailSize(iconSize.width());
@@ -1269,6 +1277,23 @@ void FolderView::setModel(ProxyFolderModel* model) {
         delete model_;
     }
     model_ = model;
+    if(model_) {
+        // the visible items may be changed without scrolling
+        connect(model_, &QAbstractItemModel::rowsInserted, this, &FolderView::queueThumbnailPriorities);
+        connect(model_, &QAbstractItemModel::rowsRemoved, this, &FolderView::queueThumbnailPriorities);
+        connect(model_, &QAbstractItemModel::layoutChanged, this, &FolderView::queueThumbnailPriorities);
+        connect(model_, &QAbstractItemModel::modelReset, this, &FolderView::queueThumbnailPriorities);
+        queueThumbnailPriorities();
+        // show that the files are being sorted in worker threads (see ProxyFolderModel::setAsyncSort())
+        connect(model_, &ProxyFolderModel::sortingChanged, this, [this](bool sorting) {
+            if(sorting) {
+                setCursor(Qt::BusyCursor);
+            }
+            else {
+                unsetCursor();
+            }
+        });
+    }
 }
 
 bool FolderView::event(QEvent* event) {
@@ -1471,6 +1496,73 @@ void FolderView::invertSelection() {
     }
 }
 
+void FolderView::queueThumbnailPriorities() {
+    if(!hasPendingThumbnailPriorities_) {
+        // wait for the view to be laid out
+        QTimer::singleShot(0, this, &FolderView::updateThumbnailPriorities);
+        hasPendingThumbnailPriorities_ = true;
+    }
+}
+
+// tells the model which items are visible, so that their thumbnails are loaded first
+void FolderView::updateThumbnailPriorities() {
+    hasPendingThumbnailPriorities_ = false;
+    if(!view || !model_ || !model_->showThumbnails()) {
+        return;
+    }
+    // The items are laid out in the order of their rows, from top to bottom (and left to right
+    // in a row of icons), or from left to right in columns in the compact mode. So, the first
+    // and last visible rows are found with binary searches.
+    const QRect viewRect = view->viewport()->rect();
+    const bool columns = mode == CompactMode;
+    auto isBefore = [this, &viewRect, columns](int row) {
+        QRect rect = view->visualRect(model_->index(row, 0));
+        return columns ? rect.right() < viewRect.left() : rect.bottom() < viewRect.top();
+    };
+    auto isAfter = [this, &viewRect, columns](int row) {
+        QRect rect = view->visualRect(model_->index(row, 0));
+        return columns ? rect.left() > viewRect.right() : rect.top() > viewRect.bottom();
+    };
+    int low = 0, high = model_->rowCount();
+    while(low < high) {
+        int mid = (low + high) / 2;
+        if(isBefore(mid)) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+    const int first = low;
+    high = model_->rowCount();
+    while(low < high) {
+        int mid = (low + high) / 2;
+        if(isAfter(mid)) {
+            high = mid;
+        }
+        else {
+            low = mid + 1;
+        }
+    }
+    const int last = low - 1;
+    // the items of a page before and after the visible ones are prefetched
+    model_->prioritizeThumbnails(first, last, last - first + 1);
+}
+
+void FolderView::setQuickFilter(const QString& text) {
+    if(model_) {
+        model_->setQuickFilter(text);
+        // keep the current file in view if it is still shown
+        if(view && view->currentIndex().isValid()) {
+            view->scrollTo(view->currentIndex());
+        }
+    }
+}
+
+QString FolderView::quickFilter() const {
+    return model_ ? model_->quickFilter() : QString();
+}
+
 void FolderView::childDragEnterEvent(QDragEnterEvent* event) {
     //qDebug("drag enter");
     if(event->mimeData()->hasFormat(QStringLiteral("text/uri-list"))) {
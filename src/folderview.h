@@ -106,6 +106,11 @@ public:
 
     void invertSelection();
 
+    // shows only the files whose names contain the text, for filtering them while typing
+    // (see ProxyFolderModel::setQuickFilter())
+    void setQuickFilter(const QString& text);
+    QString quickFilter() const;
+
     void setFileLauncher(FileLauncher* launcher) {
         fileLauncher_ = launcher;
     }
@@ -173,6 +178,8 @@ private Q_SLOTS:
     void onSelChangedTimeout();
     void onClosingEditor(QWidget* editor, QAbstractItemDelegate::EndEditHint hint);
     void scrollSmoothly();
+    void queueThumbnailPriorities();
+    void updateThumbnailPriorities();
 
 Q_SIGNALS:
     void clicked(int type, const std::shared_ptr<const Fm::FileInfo>& file);
@@ -199,6 +206,7 @@ private:
     QSize itemDelegateMargins_;
     bool shadowHidden_;
     bool ctrlRightClick_; // show folder context menu with Ctrl + right click
+    bool hasPendingThumbnailPriorities_;
 
     // smooth scrolling:
     struct scrollData {
@@ -20,10 +20,27 @@
 
 #include "proxyfoldermodel.h"
 #include "foldermodel.h"
+#include "filenameindex.h"
+#include "core/filesortjob.h"
+#include "core/parallelfor.h"
 #include <QCollator>
+#include <QThreadPool>
+#include <QTimer>
+#include <unordered_set>
+#include <algorithm>
 
 namespace Fm {
 
+// the inserted rows are merged with the sorted rows if there are at least this many of them
+static const int minMergedRows = 64;
+// the inserted rows are merged at most once in this interval (in milliseconds)
+static const int mergeInterval = 200;
+
+// the files are filtered in worker threads if there are at least this many of them
+static const int minParallelFilterRows = 10000;
+// the chunks of files filtered by each thread are not smaller than this
+static const size_t minFilterChunkSize = 2048;
+
 ProxyFolderModel::ProxyFolderModel(QObject* parent):
     QSortFilterProxyModel(parent),
     showHidden_(false),
@@ -31,19 +48,35 @@ ProxyFolderModel::ProxyFolderModel(QObject* parent):
     folderFirst_(true),
     hiddenLast_(false),
     showThumbnails_(false),
-    thumbnailSize_(0) {
+    thumbnailSize_(0),
+    asyncSort_(false),
+    asyncSortMinRows_(20000),
+    sortJob_(nullptr),
+    sortJobColumn_(-1),
+    sortJobOrder_(Qt::AscendingOrder),
+    sourceGeneration_(0),
+    sortJobGeneration_(0),
+    mergingInsertedRows_(false),
+    appendingRows_(false),
+    mergeTimer_(new QTimer(this)),
+    filtersGeneration_(0) {
 
     setDynamicSortFilter(true);
+    mergeTimer_->setSingleShot(true);
+    mergeTimer_->setInterval(mergeInterval);
+    connect(mergeTimer_, &QTimer::timeout, this, &ProxyFolderModel::onMergeTimeout);
     setSortCaseSensitivity(Qt::CaseInsensitive);
 
     collator_.setNumericMode(true);
 }
 
 ProxyFolderModel::~ProxyFolderModel() {
+    cancelSortJob();
     if(showThumbnails_ && thumbnailSize_ != 0) {
         FolderModel* srcModel = static_cast<FolderModel*>(sourceModel());
         // tell the source model that we don't need the thumnails anymore
         if(srcModel) {
+            srcModel->prioritizeThumbnails(this, thumbnailSize_, {}, {});
             srcModel->releaseThumbnails(thumbnailSize_);
             disconnect(srcModel, SIGNAL(thumbnailLoaded(QModelIndex, int)));
         }
@@ -60,10 +93,53 @@ void ProxyFolderModel::setSourceModel(QAbstractItemModel* model) {
         disconnect(oldSrcModel, SIGNAL(destroyed()), this, SLOT(_q_sourceModelDestroyed()));
     }
 #endif
+    if(oldSrcModel) {
+        disconnect(oldSrcModel, &QAbstractItemModel::rowsAboutToBeRemoved, this, &ProxyFolderModel::onSourceRowsAboutToBeRemoved);
+        disconnect(oldSrcModel, &QAbstractItemModel::modelReset, this, &ProxyFolderModel::clearSortKeys);
+        disconnect(oldSrcModel, nullptr, this, SLOT(onSourceChanged()));
+        disconnect(oldSrcModel, &QAbstractItemModel::dataChanged, this, &ProxyFolderModel::onSourceDataChanged);
+        disconnect(oldSrcModel, &QAbstractItemModel::layoutChanged, this, &ProxyFolderModel::onSourceLayoutChanged);
+        disconnect(oldSrcModel, &QAbstractItemModel::rowsAboutToBeInserted, this, &ProxyFolderModel::onSourceRowsAboutToBeInserted);
+        disconnect(oldSrcModel, &QAbstractItemModel::rowsInserted, this, &ProxyFolderModel::onSourceRowsInserted);
+        disconnect(oldSrcModel, &QAbstractItemModel::rowsInserted, this, &ProxyFolderModel::indexSourceRows);
+        disconnect(oldSrcModel, &QAbstractItemModel::modelReset, this, &ProxyFolderModel::rebuildQuickFilterIndex);
+        disconnect(oldSrcModel, &QAbstractItemModel::layoutAboutToBeChanged, this, &ProxyFolderModel::mergeInsertedRows);
+        disconnect(oldSrcModel, &QAbstractItemModel::modelAboutToBeReset, this, &ProxyFolderModel::mergeInsertedRows);
+        oldSrcModel->prioritizeThumbnails(this, thumbnailSize_, {}, {});
+    }
+    // the rows of the new model are sorted when it is set
+    const bool wasAppendingRows = appendingRows_;
+    appendingRows_ = false;
+    unmergedItems_.clear();
+    mergeTimer_->stop();
+    clearSortKeys();
+    filterVerdicts_.clear();
+    if(quickFilterIndex_) {
+        quickFilterIndex_->clear();
+    }
+    cancelSortJob();
+    ++sourceGeneration_;
     if(model) {
         // we only support Fm::FolderModel
         Q_ASSERT(model->inherits("Fm::FolderModel"));
 
+        // forget the sort keys of the removed files
+        connect(model, &QAbstractItemModel::rowsAboutToBeRemoved, this, &ProxyFolderModel::onSourceRowsAboutToBeRemoved);
+        connect(model, &QAbstractItemModel::modelReset, this, &ProxyFolderModel::clearSortKeys);
+        // the result of a sort job is only valid for the rows it is made for
+        connect(model, &QAbstractItemModel::rowsInserted, this, &ProxyFolderModel::onSourceChanged);
+        connect(model, &QAbstractItemModel::rowsRemoved, this, &ProxyFolderModel::onSourceChanged);
+        connect(model, &QAbstractItemModel::dataChanged, this, &ProxyFolderModel::onSourceDataChanged);
+        connect(model, &QAbstractItemModel::layoutChanged, this, &ProxyFolderModel::onSourceLayoutChanged);
+        connect(model, &QAbstractItemModel::modelReset, this, &ProxyFolderModel::onSourceChanged);
+        // the quick filter index should know the new files before they are filtered
+        connect(model, &QAbstractItemModel::rowsInserted, this, &ProxyFolderModel::indexSourceRows);
+        connect(model, &QAbstractItemModel::modelReset, this, &ProxyFolderModel::rebuildQuickFilterIndex);
+        // the appended rows should be merged before the rows are moved
+        // (and before QSortFilterProxyModel handles the changes)
+        connect(model, &QAbstractItemModel::layoutAboutToBeChanged, this, &ProxyFolderModel::mergeInsertedRows);
+        connect(model, &QAbstractItemModel::modelAboutToBeReset, this, &ProxyFolderModel::mergeInsertedRows);
+
         if(showThumbnails_ && thumbnailSize_ != 0) { // if we're showing thumbnails
             if(oldSrcModel) { // we need to release cached thumbnails for the old source model
                 oldSrcModel->releaseThumbnails(thumbnailSize_);
@@ -77,19 +153,250 @@ void ProxyFolderModel::setSourceModel(QAbstractItemModel* model) {
         }
     }
     QSortFilterProxyModel::setSourceModel(model);
+    if(wasAppendingRows) {
+        setDynamicSortFilter(true);
+    }
+    // NOTE: Until the index is rebuilt, the files that are not indexed are tested one by one.
+    rebuildQuickFilterIndex();
+    if(model) {
+        // NOTE: onSourceRowsInserted() should be called after QSortFilterProxyModel has inserted the rows.
+        connect(model, &QAbstractItemModel::rowsAboutToBeInserted, this, &ProxyFolderModel::onSourceRowsAboutToBeInserted);
+        connect(model, &QAbstractItemModel::rowsInserted, this, &ProxyFolderModel::onSourceRowsInserted);
+    }
 }
 
 void ProxyFolderModel::sort(int column, Qt::SortOrder order) {
+    mergeInsertedRows();
     int oldColumn = sortColumn();
     Qt::SortOrder oldOrder = sortOrder();
+    if(sortJob_) { // the last request wins
+        if(column == sortJobColumn_ && order == sortJobOrder_) {
+            return;
+        }
+        cancelSortJob();
+    }
+    if(asyncSort_ && column >= 0 && (column != oldColumn || order != oldOrder)
+       && sourceModel() && sourceModel()->rowCount() >= asyncSortMinRows_) {
+        startSortJob(column, order);
+        Q_EMIT sortingChanged(true);
+        return;
+    }
     QSortFilterProxyModel::sort(column, order);
     if(column != oldColumn || order != oldOrder) {
         Q_EMIT sortFilterChanged();
     }
 }
 
+void ProxyFolderModel::setAsyncSort(bool async, int minRows) {
+    asyncSort_ = async;
+    asyncSortMinRows_ = minRows;
+}
+
+void ProxyFolderModel::startSortJob(int column, Qt::SortOrder order) {
+    FolderModel* srcModel = static_cast<FolderModel*>(sourceModel());
+    FileSortJob::Options options;
+    switch(column) {
+    case FolderModel::ColumnFileMTime:
+    case FolderModel::ColumnFileSize:
+        options.key = FileSortJob::Key::Number;
+        break;
+    case FolderModel::ColumnFileName:
+        options.key = srcModel->showFullNames() ? FileSortJob::Key::Text : FileSortJob::Key::Name;
+        break;
+    default:
+        options.key = FileSortJob::Key::Text;
+        break;
+    }
+    options.order = order;
+    options.folderFirst = folderFirst_;
+    options.hiddenLast = hiddenLast_;
+    options.locale = collator_.locale();
+    options.caseSensitivity = collator_.caseSensitivity();
+    options.numericMode = collator_.numericMode();
+
+    // Snapshot the sort keys of the files in the order of the source rows.
+    // NOTE: The texts of Key::Text columns (like types or owners) are got from the source model
+    // in the GUI thread, since FolderModel::data() is not thread-safe. This costs one call per row,
+    // but the collation keys, which are much more expensive, are made by the job.
+    auto job = new FileSortJob(options);
+    const int n_rows = srcModel->rowCount();
+    for(int row = 0; row < n_rows; ++row) {
+        QModelIndex index = srcModel->index(row, 0);
+        const auto& info = srcModel->itemFromIndex(index)->info;
+        switch(options.key) {
+        case FileSortJob::Key::Number:
+            job->addFile(info, column == FolderModel::ColumnFileMTime ? info->mtime() : info->size());
+            break;
+        case FileSortJob::Key::Text:
+            job->addFile(info, 0, srcModel->data(srcModel->index(row, column), Qt::DisplayRole).toString());
+            break;
+        default:
+            job->addFile(info);
+            break;
+        }
+    }
+
+    sortJob_ = job;
+    sortJobColumn_ = column;
+    sortJobOrder_ = order;
+    sortJobGeneration_ = sourceGeneration_;
+    job->setAutoDelete(true);
+    // NOTE: the job waits for the result to be used before it is deleted
+    connect(job, &FileSortJob::finished, this, &ProxyFolderModel::onSortJobFinished, Qt::BlockingQueuedConnection);
+    QThreadPool::globalInstance()->start(job);
+}
+
+void ProxyFolderModel::cancelSortJob() {
+    if(sortJob_) {
+        disconnect(sortJob_, &FileSortJob::finished, this, &ProxyFolderModel::onSortJobFinished);
+        sortJob_->cancel();
+        sortJob_ = nullptr;
+        Q_EMIT sortingChanged(false);
+    }
+}
+
+void ProxyFolderModel::onSortJobFinished() {
+    FileSortJob* job = static_cast<FileSortJob*>(sender());
+    if(job != sortJob_) {
+        return;
+    }
+    sortJob_ = nullptr;
+    FolderModel* srcModel = static_cast<FolderModel*>(sourceModel());
+    if(job->isCancelled() || !srcModel) {
+        Q_EMIT sortingChanged(false);
+        return;
+    }
+    const auto& sortedIndexes = job->sortedIndexes();
+    if(sortJobGeneration_ != sourceGeneration_ || sortedIndexes.size() != size_t(srcModel->rowCount())) {
+        // The source model has changed since the job was started, so its result is not valid.
+        // The files are sorted again by a new job, and the old order is kept meanwhile.
+        // NOTE: If the folder keeps changing faster than it can be sorted, the old order is kept
+        // until it stops changing (the new rows are inserted in that order meanwhile).
+        startSortJob(sortJobColumn_, sortJobOrder_);
+        return;
+    }
+
+    int oldColumn = sortColumn();
+    Qt::SortOrder oldOrder = sortOrder();
+    rankByRow_.resize(sortedIndexes.size());
+    for(size_t rank = 0; rank < sortedIndexes.size(); ++rank) {
+        rankByRow_[sortedIndexes[rank]] = rank;
+    }
+    // keep the collation keys for sorting the files that will be added or changed
+    // (the collator is not changed while the job is running, and the files of the
+    // jobs are in the order of the source rows, which are not changed either)
+    for(size_t i = 0; i < job->fileCount(); ++i) {
+        const FolderModelItem* item = srcModel->itemFromIndex(srcModel->index(i, 0));
+        if(sortKeys_.find(item) == sortKeys_.end()) {
+            sortKeys_.emplace(item, SortKey{job->file(i), job->nameKey(i)});
+        }
+    }
+    // a single layout change, in which lessThan() only compares the ranks
+    QSortFilterProxyModel::sort(sortJobColumn_, sortJobOrder_);
+    rankByRow_.clear();
+    if(sortJobColumn_ != oldColumn || sortJobOrder_ != oldOrder) {
+        Q_EMIT sortFilterChanged();
+    }
+    Q_EMIT sortingChanged(false);
+}
+
+void ProxyFolderModel::onSourceChanged() {
+    ++sourceGeneration_;
+}
+
+// QSortFilterProxyModel inserts sorted rows by finding their positions with binary searches,
+// but it updates its whole mapping for each group of rows inserted at the same position, which
+// costs O(n) per inserted row when the rows of a big batch are scattered. So, the rows of big
+// batches are appended unsorted and then merged with the sorted rows in a single layout change.
+// NOTE: QSortFilterProxyModel does not allow inserting rows at given positions of its mapping,
+// so a merge still costs O(n) to find the new rows, and QSortFilterProxyModel sorts all rows
+// again by their merged positions (O(n log n) cheap comparisons) and relayouts them. This is not
+// O(k log n) for a batch of k rows. To limit that cost when a folder is loaded in many batches,
+// the first big batch is merged at once, and the rows inserted during the next mergeInterval ms
+// are appended unsorted and merged together when it ends, so that a continuous stream of batches
+// is merged about 1000 / mergeInterval times per second, whatever the size of the batches.
+void ProxyFolderModel::onSourceRowsAboutToBeInserted(const QModelIndex& /*parent*/, int first, int last) {
+    if(appendingRows_) {
+        // the dynamic sorting is still disabled, so the rows are appended too
+        mergingInsertedRows_ = true;
+    }
+    else if(dynamicSortFilter() && sortColumn() >= 0 && rowCount() > 0 && last - first + 1 >= minMergedRows) {
+        mergingInsertedRows_ = true;
+        appendingRows_ = true;
+        // the rows are appended as a single group when the dynamic sorting is disabled
+        setDynamicSortFilter(false);
+    }
+}
+
+void ProxyFolderModel::onSourceRowsInserted(const QModelIndex& /*parent*/, int first, int last) {
+    if(!mergingInsertedRows_) {
+        return;
+    }
+    mergingInsertedRows_ = false;
+    FolderModel* srcModel = static_cast<FolderModel*>(sourceModel());
+    for(int row = first; row <= last; ++row) {
+        unmergedItems_.insert(srcModel->itemFromIndex(srcModel->index(row, 0)));
+    }
+    if(!mergeTimer_->isActive()) {
+        mergeInsertedRows();
+        mergeTimer_->start();
+    }
+}
+
+void ProxyFolderModel::onMergeTimeout() {
+    if(appendingRows_) {
+        mergeInsertedRows();
+        // the rows inserted in the next interval are merged when it ends
+        mergeTimer_->start();
+    }
+}
+
+// merges the appended rows with the sorted rows, and enables the dynamic sorting again
+void ProxyFolderModel::mergeInsertedRows() {
+    if(!appendingRows_) {
+        return;
+    }
+    appendingRows_ = false;
+    FolderModel* srcModel = static_cast<FolderModel*>(sourceModel());
+    const int column = sortColumn();
+    if(!srcModel || column < 0) {
+        unmergedItems_.clear();
+        setDynamicSortFilter(true);
+        return;
+    }
+    // whether the source row a is shown before the source row b
+    auto before = [this, srcModel, column](int a, int b) {
+        QModelIndex left = srcModel->index(a, column);
+        QModelIndex right = srcModel->index(b, column);
+        return sortOrder() == Qt::AscendingOrder ? lessThan(left, right) : lessThan(right, left);
+    };
+
+    // the old rows are still sorted, and the accepted new rows are appended
+    const int n_rows = rowCount();
+    std::vector<int> oldRows, newRows;
+    oldRows.reserve(n_rows);
+    for(int row = 0; row < n_rows; ++row) {
+        int srcRow = mapToSource(index(row, 0)).row();
+        bool isNew = unmergedItems_.count(srcModel->itemFromIndex(srcModel->index(srcRow, 0))) != 0;
+        (isNew ? newRows : oldRows).push_back(srcRow);
+    }
+    unmergedItems_.clear();
+    std::stable_sort(newRows.begin(), newRows.end(), before);
+    std::vector<int> rows(n_rows);
+    std::merge(oldRows.cbegin(), oldRows.cend(), newRows.cbegin(), newRows.cend(), rows.begin(), before);
+
+    // re-enabling the dynamic sorting sorts the rows, in which lessThan() compares their merged positions
+    rankByRow_.assign(srcModel->rowCount(), 0);
+    for(int i = 0; i < n_rows; ++i) {
+        rankByRow_[rows[i]] = sortOrder() == Qt::AscendingOrder ? i : n_rows - 1 - i;
+    }
+    setDynamicSortFilter(true);
+    rankByRow_.clear();
+}
+
 void ProxyFolderModel::setShowHidden(bool show) {
     if(show != showHidden_) {
+        mergeInsertedRows();
         showHidden_ = show;
         invalidateFilter();
         Q_EMIT sortFilterChanged();
@@ -98,6 +405,7 @@ void ProxyFolderModel::setShowHidden(bool show) {
 
 void ProxyFolderModel::setBackupAsHidden(bool backupAsHidden) {
     if(backupAsHidden != backupAsHidden_) {
+        mergeInsertedRows();
         backupAsHidden_ = backupAsHidden;
         invalidateFilter();
         Q_EMIT sortFilterChanged();
@@ -107,6 +415,7 @@ void ProxyFolderModel::setBackupAsHidden(bool backupAsHidden) {
 // need to call invalidateFilter() manually.
 void ProxyFolderModel::setFolderFirst(bool folderFirst) {
     if(folderFirst != folderFirst_) {
+        mergeInsertedRows();
         folderFirst_ = folderFirst;
         invalidate();
         Q_EMIT sortFilterChanged();
@@ -115,6 +424,7 @@ void ProxyFolderModel::setFolderFirst(bool folderFirst) {
 
 void ProxyFolderModel::setHiddenLast(bool hiddenLast) {
     if(hiddenLast != hiddenLast_) {
+        mergeInsertedRows();
         hiddenLast_ = hiddenLast;
         invalidate();
         Q_EMIT sortFilterChanged();
@@ -122,39 +432,101 @@ void ProxyFolderModel::setHiddenLast(bool hiddenLast) {
 }
 
 void ProxyFolderModel::setSortCaseSensitivity(Qt::CaseSensitivity cs) {
+    cancelSortJob();
+    mergeInsertedRows();
     collator_.setCaseSensitivity(cs);
+    clearSortKeys(); // the keys depend on the collator
     QSortFilterProxyModel::setSortCaseSensitivity(cs);
     invalidate();
     Q_EMIT sortFilterChanged();
 }
 
-bool ProxyFolderModel::filterAcceptsRow(int source_row, const QModelIndex& source_parent) const {
-    if(!showHidden_) {
-        if(FolderModel* srcModel = static_cast<FolderModel*>(sourceModel())) {
-            auto info = srcModel->fileInfoFromIndex(srcModel->index(source_row, 0, source_parent));
-            if(info && (info->isHidden() || (backupAsHidden_ && info->isBackup()))) {
-                return false;
-            }
+void ProxyFolderModel::setQuickFilter(const QString& text) {
+    if(text == quickFilter_) {
+        return;
+    }
+    quickFilter_ = text;
+    if(text.isEmpty()) {
+        // free the memory of the index
+        quickFilterIndex_.reset();
+    }
+    else {
+        if(!quickFilterIndex_) {
+            quickFilterIndex_ = std::unique_ptr<FileNameIndex>{new FileNameIndex()};
+            rebuildQuickFilterIndex();
+        }
+        if(!quickFilterIndex_->setQuery(text)) {
+            return; // only the case of the text is changed
         }
     }
-    // apply additional filters if there're any
+    mergeInsertedRows();
+    invalidateFilter();
+    Q_EMIT sortFilterChanged();
+}
+
+void ProxyFolderModel::indexSourceRows(const QModelIndex& /*parent*/, int first, int last) {
+    if(quickFilterIndex_) {
+        FolderModel* srcModel = static_cast<FolderModel*>(sourceModel());
+        for(int row = first; row <= last; ++row) {
+            quickFilterIndex_->addItem(srcModel->itemFromIndex(srcModel->index(row, 0)));
+        }
+    }
+}
+
+void ProxyFolderModel::rebuildQuickFilterIndex() {
+    if(quickFilterIndex_) {
+        quickFilterIndex_->clear();
+        indexSourceRows(QModelIndex(), 0, sourceModel() ? sourceModel()->rowCount() - 1 : -1);
+    }
+}
+
+bool ProxyFolderModel::filterAcceptsRow(int source_row, const QModelIndex& source_parent) const {
+    FolderModel* srcModel = static_cast<FolderModel*>(sourceModel());
+    FolderModelItem* item = srcModel ? srcModel->itemFromIndex(srcModel->index(source_row, 0, source_parent)) : nullptr;
+    if(!item) {
+        return true;
+    }
+    const auto& info = item->info;
+    // the cheap tests of the flags of the file come first
+    if(!showHidden_ && (info->isHidden() || (backupAsHidden_ && info->isBackup()))) {
+        return false;
+    }
+    if(quickFilterIndex_ && !quickFilterIndex_->matches(item)) {
+        return false;
+    }
+    if(filters_.isEmpty()) {
+        return true;
+    }
+
+    // The verdicts of the additional filters, which may test names with patterns, are cached
+    // until the filters are updated. So, showing or hiding hidden files does not test them again.
+    auto it = filterVerdicts_.find(item);
+    if(it != filterVerdicts_.end() && it->second.info == info.get() && it->second.generation == filtersGeneration_) {
+        return it->second.accepted;
+    }
+    bool accepted = true;
     for(ProxyFolderModelFilter* const filter : qAsConst(filters_)) {
-        if(FolderModel* srcModel = static_cast<FolderModel*>(sourceModel())){
-            auto fileInfo = srcModel->fileInfoFromIndex(srcModel->index(source_row, 0, source_parent));
-            if(!filter->filterAcceptsRow(this, fileInfo)) {
-                return false;
-            }
+        if(!filter->filterAcceptsRow(this, info)) {
+            accepted = false;
+            break;
         }
     }
-    return true;
+    filterVerdicts_[item] = FilterVerdict{info.get(), filtersGeneration_, accepted};
+    return accepted;
 }
 
 bool ProxyFolderModel::lessThan(const QModelIndex& left, const QModelIndex& right) const {
+    if(!rankByRow_.empty()) { // a precomputed order of the rows is being applied
+        return rankByRow_[left.row()] < rankByRow_[right.row()];
+    }
     FolderModel* srcModel = static_cast<FolderModel*>(sourceModel());
     // left and right are indexes of source model, not the proxy model.
     if(srcModel) {
-        auto leftInfo = srcModel->fileInfoFromIndex(left);
-        auto rightInfo = srcModel->fileInfoFromIndex(right);
+        // NOTE: the file infos are not copied to avoid changing their reference counts per comparison
+        const FolderModelItem* leftItem = srcModel->itemFromIndex(left);
+        const FolderModelItem* rightItem = srcModel->itemFromIndex(right);
+        const auto& leftInfo = leftItem->info;
+        const auto& rightInfo = rightItem->info;
 
         if(folderFirst_) {
             bool leftIsFolder = leftInfo->isDir();
@@ -184,6 +556,12 @@ bool ProxyFolderModel::lessThan(const QModelIndex& left, const QModelIndex& righ
                 return leftInfo->size() < rightInfo->size();
             }
             break;
+        case FolderModel::ColumnFileName:
+            if(!srcModel->showFullNames()) {
+                // the display names are compared below
+                break;
+            }
+            /* Falls through. */
         default: {
             QString leftText = left.data(Qt::DisplayRole).toString();
             QString rightText = right.data(Qt::DisplayRole).toString();
@@ -193,13 +571,114 @@ bool ProxyFolderModel::lessThan(const QModelIndex& left, const QModelIndex& righ
         }
         // always sort files by their display names when they have the same property
         if(comp == 0) {
-            return collator_.compare(leftInfo->displayName(), rightInfo->displayName()) < 0;
+            return sortKey(leftItem).compare(sortKey(rightItem)) < 0;
         }
         return comp < 0;
     }
     return QSortFilterProxyModel::lessThan(left, right);
 }
 
+// Returns the collation key of the display name of the file of the item, which is made only once
+// (when the file is sorted for the first time), so that comparing two names is cheap.
+const QCollatorSortKey& ProxyFolderModel::sortKey(const FolderModelItem* item) const {
+    auto it = sortKeys_.find(item);
+    if(it == sortKeys_.end()) {
+        it = sortKeys_.emplace(item, SortKey{item->info, collator_.sortKey(item->info->displayName())}).first;
+    }
+    else if(it->second.info != item->info) {
+        // the file is replaced, or the item is reused, before the change is handled here
+        // (QSortFilterProxyModel may sort the rows before onSourceDataChanged() is called)
+        it->second = SortKey{item->info, collator_.sortKey(item->info->displayName())};
+    }
+    return it->second.key;
+}
+
+// removes the keys of the items that are not in the source model anymore
+void ProxyFolderModel::pruneSortKeys() {
+    if(sortKeys_.empty()) {
+        return;
+    }
+    FolderModel* srcModel = static_cast<FolderModel*>(sourceModel());
+    std::unordered_set<const FolderModelItem*> items;
+    items.reserve(srcModel->rowCount());
+    for(int row = 0; row < srcModel->rowCount(); ++row) {
+        items.insert(srcModel->itemFromIndex(srcModel->index(row, 0)));
+    }
+    for(auto it = sortKeys_.begin(); it != sortKeys_.end();) {
+        if(items.count(it->first) == 0) {
+            it = sortKeys_.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+void ProxyFolderModel::clearSortKeys() {
+    sortKeys_.clear();
+}
+
+void ProxyFolderModel::onSourceRowsAboutToBeRemoved(const QModelIndex& /*parent*/, int first, int last) {
+    FolderModel* srcModel = static_cast<FolderModel*>(sourceModel());
+    if(first == 0 && last == srcModel->rowCount() - 1) {
+        clearSortKeys();
+        filterVerdicts_.clear();
+        unmergedItems_.clear();
+        if(quickFilterIndex_) {
+            quickFilterIndex_->clear();
+        }
+        return;
+    }
+    if(!sortKeys_.empty() || !filterVerdicts_.empty() || !unmergedItems_.empty() || quickFilterIndex_) {
+        for(int row = first; row <= last; ++row) {
+            FolderModelItem* item = srcModel->itemFromIndex(srcModel->index(row, 0));
+            sortKeys_.erase(item);
+            filterVerdicts_.erase(item);
+            unmergedItems_.erase(item);
+            if(quickFilterIndex_) {
+                quickFilterIndex_->removeItem(item);
+            }
+        }
+    }
+}
+
+void ProxyFolderModel::onSourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight) {
+    ++sourceGeneration_;
+    // the changed rows are moved by QSortFilterProxyModel only if the dynamic sorting is enabled
+    mergeInsertedRows();
+    // the files of the rows may be replaced
+    if(!sortKeys_.empty() || !filterVerdicts_.empty() || quickFilterIndex_) {
+        FolderModel* srcModel = static_cast<FolderModel*>(sourceModel());
+        for(int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+            FolderModelItem* item = srcModel->itemFromIndex(srcModel->index(row, 0));
+            // release the replaced file at once
+            auto it = sortKeys_.find(item);
+            if(it != sortKeys_.end() && it->second.info != item->info) {
+                sortKeys_.erase(it);
+            }
+            filterVerdicts_.erase(item);
+            if(quickFilterIndex_) {
+                quickFilterIndex_->addItem(item); // the file may be renamed
+            }
+        }
+    }
+}
+
+void ProxyFolderModel::onSourceLayoutChanged() {
+    ++sourceGeneration_;
+    // the items of removed rows may be reused by new rows (see FolderModel::removeScatteredRows())
+    filterVerdicts_.clear();
+    pruneSortKeys();
+    if(quickFilterIndex_) {
+        FolderModel* srcModel = static_cast<FolderModel*>(sourceModel());
+        std::vector<const FolderModelItem*> items(srcModel->rowCount());
+        for(size_t row = 0; row < items.size(); ++row) {
+            items[row] = srcModel->itemFromIndex(srcModel->index(row, 0));
+        }
+        quickFilterIndex_->syncItems(items);
+    }
+}
+
 std::shared_ptr<const Fm::FileInfo> ProxyFolderModel::fileInfoFromIndex(const QModelIndex& index) const {
     if(index.isValid()) {
         FolderModel* srcModel = static_cast<FolderModel*>(sourceModel());
@@ -242,6 +721,7 @@ void ProxyFolderModel::setShowThumbnails(bool show) {
             }
             else { // turn off thumbnails
                 // free cached old thumbnails in souce model
+                srcModel->prioritizeThumbnails(this, thumbnailSize_, {}, {});
                 srcModel->releaseThumbnails(thumbnailSize_);
                 disconnect(srcModel, SIGNAL(thumbnailLoaded(QModelIndex, int)));
             }
@@ -257,6 +737,8 @@ void ProxyFolderModel::setThumbnailSize(int size) {
         if(showThumbnails_ && srcModel) {
             // free cached thumbnails of the old size
             if(thumbnailSize_ != 0) {
+                // the rows shown by the view are told again for the new size
+                srcModel->prioritizeThumbnails(this, thumbnailSize_, {}, {});
                 srcModel->releaseThumbnails(thumbnailSize_);
             }
             else {
@@ -273,6 +755,21 @@ void ProxyFolderModel::setThumbnailSize(int size) {
     }
 }
 
+void ProxyFolderModel::prioritizeThumbnails(int firstVisibleRow, int lastVisibleRow, int prefetchedRows) {
+    FolderModel* srcModel = static_cast<FolderModel*>(sourceModel());
+    if(!srcModel || !showThumbnails_ || thumbnailSize_ == 0) {
+        return;
+    }
+    std::vector<int> visibleRows, prefetched;
+    const int first = std::max(0, firstVisibleRow - prefetchedRows);
+    const int last = std::min(rowCount() - 1, lastVisibleRow + prefetchedRows);
+    for(int row = first; row <= last; ++row) {
+        int srcRow = mapToSource(index(row, 0)).row();
+        (row >= firstVisibleRow && row <= lastVisibleRow ? visibleRows : prefetched).push_back(srcRow);
+    }
+    srcModel->prioritizeThumbnails(this, thumbnailSize_, visibleRows, prefetched);
+}
+
 QVariant ProxyFolderModel::data(const QModelIndex& index, int role) const {
     if(index.column() == 0) { // only show the decoration role for the first column
         if(role == Qt::DecorationRole && showThumbnails_ && thumbnailSize_) {
@@ -301,19 +798,76 @@ void ProxyFolderModel::onThumbnailLoaded(const QModelIndex& srcIndex, int size)
     }
 }
 
+// If all the additional filters are thread-safe, evaluates them for a snapshot of the files of
+// a big folder in worker threads, and caches the verdicts in a single pass. Then refiltering the
+// rows only looks up the verdicts, instead of testing the files one by one in the GUI thread.
+void ProxyFolderModel::evaluateFilters() {
+    FolderModel* srcModel = static_cast<FolderModel*>(sourceModel());
+    if(!srcModel || filters_.isEmpty() || srcModel->rowCount() < minParallelFilterRows) {
+        return;
+    }
+    for(ProxyFolderModelFilter* const filter : qAsConst(filters_)) {
+        if(!filter->isThreadSafe()) {
+            return;
+        }
+    }
+
+    const size_t n_rows = srcModel->rowCount();
+    std::vector<const FolderModelItem*> items(n_rows);
+    for(size_t row = 0; row < n_rows; ++row) {
+        items[row] = srcModel->itemFromIndex(srcModel->index(row, 0));
+    }
+    // NOTE: std::vector<bool> is not used, since its elements cannot be written by different threads
+    std::vector<char> accepted(n_rows);
+    const size_t n_chunks = parallelChunkCount(n_rows, minFilterChunkSize);
+    parallelFor(n_chunks, [this, &items, &accepted, n_rows, n_chunks](size_t chunk) {
+        const size_t end = n_rows * (chunk + 1) / n_chunks;
+        for(size_t i = n_rows * chunk / n_chunks; i < end; ++i) {
+            const auto& info = items[i]->info;
+            bool ok = true;
+            for(ProxyFolderModelFilter* const filter : qAsConst(filters_)) {
+                if(!filter->filterAcceptsRow(this, info)) {
+                    ok = false;
+                    break;
+                }
+            }
+            accepted[i] = ok;
+        }
+    });
+
+    filterVerdicts_.reserve(n_rows);
+    for(size_t i = 0; i < n_rows; ++i) {
+        filterVerdicts_[items[i]] = FilterVerdict{items[i]->info.get(), filtersGeneration_, accepted[i] != 0};
+    }
+}
+
 void ProxyFolderModel::addFilter(ProxyFolderModelFilter* filter) {
+    mergeInsertedRows();
     filters_.append(filter);
+    ++filtersGeneration_;
+    evaluateFilters();
     invalidateFilter();
     Q_EMIT sortFilterChanged();
 }
 
 void ProxyFolderModel::removeFilter(ProxyFolderModelFilter* filter) {
+    mergeInsertedRows();
     filters_.removeOne(filter);
+    ++filtersGeneration_;
+    if(filters_.isEmpty()) {
+        filterVerdicts_.clear();
+    }
+    else {
+        evaluateFilters();
+    }
     invalidateFilter();
     Q_EMIT sortFilterChanged();
 }
 
 void ProxyFolderModel::updateFilters() {
+    mergeInsertedRows();
+    ++filtersGeneration_;
+    evaluateFilters();
     invalidate();
     Q_EMIT sortFilterChanged();
 }
@@ -25,20 +25,34 @@
 #include <QSortFilterProxyModel>
 #include <QList>
 #include <QCollator>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <memory>
 
 #include "core/fileinfo.h"
 
+class QTimer;
+
 namespace Fm {
 
 // a proxy model used to sort and filter FolderModel
 
 class FolderModelItem;
 class ProxyFolderModel;
+class FileSortJob;
+class FileNameIndex;
 
 class LIBFM_QT_API ProxyFolderModelFilter {
 public:
     virtual bool filterAcceptsRow(const ProxyFolderModel* model, const std::shared_ptr<const Fm::FileInfo>& info) const = 0;
     virtual ~ProxyFolderModelFilter() {}
+
+    // Should return true if filterAcceptsRow() can be called from several threads at once.
+    // Then the files of big folders are filtered in worker threads when the filters are changed.
+    virtual bool isThreadSafe() const {
+        return false;
+    }
 };
 
 
@@ -73,6 +87,29 @@ public:
 
     void setSortCaseSensitivity(Qt::CaseSensitivity cs);
 
+    // Shows only the files whose display names contain the text (case-insensitively), which
+    // is meant to be changed while the user is typing. The names are indexed (see FileNameIndex)
+    // while it is set, and a text that extends the last one only tests the names that matched it.
+    // NOTE: That narrowing is only done inside the index; the proxy model still refilters all
+    // rows on each change (with one index lookup per row), since QSortFilterProxyModel cannot
+    // refilter only some of them.
+    void setQuickFilter(const QString& text);
+    QString quickFilter() const {
+        return quickFilter_;
+    }
+
+    // If enabled, changing the sort column or order of a model with at least minRows files
+    // sorts the files in worker threads (see FileSortJob), and the result is shown with a single
+    // layout change. Meanwhile, the old order is kept and isSorting() returns true.
+    void setAsyncSort(bool async, int minRows = 20000);
+    bool asyncSort() const {
+        return asyncSort_;
+    }
+
+    bool isSorting() const {
+        return sortJob_ != nullptr;
+    }
+
     bool showThumbnails() {
         return showThumbnails_;
     }
@@ -83,6 +120,11 @@ public:
     }
     void setThumbnailSize(int size);
 
+    // Tells the source model which rows are visible, and how many rows before and after them
+    // may be shown soon, so that their thumbnails are loaded first and the thumbnails queued
+    // for the other rows are dropped (see FolderModel::prioritizeThumbnails()).
+    void prioritizeThumbnails(int firstVisibleRow, int lastVisibleRow, int prefetchedRows);
+
     std::shared_ptr<const Fm::FileInfo> fileInfoFromIndex(const QModelIndex& index) const;
 
     std::shared_ptr<const Fm::FileInfo> fileInfoFromPath(const FilePath& path) const;
@@ -94,13 +136,29 @@ public:
 
     void addFilter(ProxyFolderModelFilter* filter);
     void removeFilter(ProxyFolderModelFilter* filter);
+    // should be called when the filters are changed, since their results are cached
     void updateFilters();
 
 Q_SIGNALS:
     void sortFilterChanged();
 
+    // emitted when an asynchronous sorting is started or finished (see setAsyncSort())
+    void sortingChanged(bool sorting);
+
 protected Q_SLOTS:
     void onThumbnailLoaded(const QModelIndex& srcIndex, int size);
+    void onSourceRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last);
+    void onSourceChanged();
+    void onSourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
+    void onSourceLayoutChanged();
+    void onSourceRowsAboutToBeInserted(const QModelIndex& parent, int first, int last);
+    void onSourceRowsInserted(const QModelIndex& parent, int first, int last);
+    void indexSourceRows(const QModelIndex& parent, int first, int last);
+    void rebuildQuickFilterIndex();
+    void clearSortKeys();
+    void onSortJobFinished();
+    void mergeInsertedRows();
+    void onMergeTimeout();
 
 protected:
     bool filterAcceptsRow(int source_row, const QModelIndex& source_parent) const override;
@@ -108,7 +166,25 @@ protected:
     // void reloadAllThumbnails();
 
 private:
+    const QCollatorSortKey& sortKey(const FolderModelItem* item) const;
+    void pruneSortKeys();
+    void evaluateFilters();
+    void startSortJob(int column, Qt::SortOrder order);
+    void cancelSortJob();
+
+    // the collation key of the display name of the file of an item, which is only valid
+    // while the item has that file (the file is kept alive, so its address is not reused)
+    struct SortKey {
+        SortKey(const std::shared_ptr<const Fm::FileInfo>& _info, const QCollatorSortKey& _key):
+            info{_info},
+            key{_key} {
+        }
+        std::shared_ptr<const Fm::FileInfo> info;
+        QCollatorSortKey key;
+    };
+
     QCollator collator_;
+    mutable std::unordered_map<const FolderModelItem*, SortKey> sortKeys_;
     bool showHidden_;
     bool backupAsHidden_;
     bool folderFirst_;
@@ -116,6 +192,31 @@ private:
     bool showThumbnails_;
     int thumbnailSize_;
     QList<ProxyFolderModelFilter*> filters_;
+
+    bool asyncSort_;
+    int asyncSortMinRows_;
+    FileSortJob* sortJob_;
+    int sortJobColumn_;
+    Qt::SortOrder sortJobOrder_;
+    unsigned int sourceGeneration_; // increased whenever the source model changes
+    unsigned int sortJobGeneration_; // the source generation the running job is made for
+    std::vector<int> rankByRow_; // the sorted positions of the source rows while applying them
+    bool mergingInsertedRows_; // the inserted rows are to be merged (see onSourceRowsInserted())
+    bool appendingRows_; // the dynamic sorting is disabled until the appended rows are merged
+    std::unordered_set<const FolderModelItem*> unmergedItems_; // the items of the appended rows
+    QTimer* mergeTimer_; // limits the rate of merging
+
+    // the result of the additional filters for the file of an item
+    struct FilterVerdict {
+        const Fm::FileInfo* info;
+        unsigned int generation;
+        bool accepted;
+    };
+    mutable std::unordered_map<const FolderModelItem*, FilterVerdict> filterVerdicts_;
+    unsigned int filtersGeneration_; // increased whenever the filters are changed
+
+    QString quickFilter_;
+    std::unique_ptr<FileNameIndex> quickFilterIndex_; // only exists while there is a quick filter
 };
 
 }
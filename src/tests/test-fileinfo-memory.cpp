@@ -0,0 +1,138 @@
+// Measures the memory taken by FileInfo objects.
+// Makes FileInfo objects from synthetic GFileInfo objects, like those of a local
+// listing, and prints the growth of the resident set size of the process, and
+// the time taken to sort them by modification time and by display name.
+// Without --lean or --full, both modes are measured, each in its own process, so
+// that the RSS of one does not affect the other.
+// Usage: test-fileinfo-memory [number of files] [--lean|--full]
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "../core/fileinfo.h"
+
+static size_t residentSetSize() {
+    size_t size = 0, resident = 0;
+    if(FILE* statm = fopen("/proc/self/statm", "r")) {
+        if(fscanf(statm, "%zu %zu", &size, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(statm);
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+static Fm::GFileInfoPtr makeGFileInfo(int i) {
+    static const char* const types[] = {"text/plain", "image/png", "application/pdf", "inode/directory"};
+    std::string name = "file-" + std::to_string(i) + (i % 4 == 3 ? "" : ".ext");
+    const char* type = types[i % 4];
+    Fm::GFileInfoPtr inf{g_file_info_new(), false};
+    g_file_info_set_file_type(inf.get(), i % 4 == 3 ? G_FILE_TYPE_DIRECTORY : G_FILE_TYPE_REGULAR);
+    g_file_info_set_name(inf.get(), name.c_str());
+    g_file_info_set_display_name(inf.get(), name.c_str());
+    g_file_info_set_edit_name(inf.get(), name.c_str());
+    g_file_info_set_size(inf.get(), 1024 * i);
+    g_file_info_set_attribute_uint64(inf.get(), G_FILE_ATTRIBUTE_STANDARD_ALLOCATED_SIZE, 4096);
+    g_file_info_set_content_type(inf.get(), type);
+    Fm::GIconPtr icon{g_content_type_get_icon(type), false};
+    g_file_info_set_icon(inf.get(), icon.get());
+    g_file_info_set_attribute_uint32(inf.get(), G_FILE_ATTRIBUTE_UNIX_MODE, (i % 4 == 3 ? S_IFDIR : S_IFREG) | 0644);
+    g_file_info_set_attribute_uint32(inf.get(), G_FILE_ATTRIBUTE_UNIX_UID, 1000);
+    g_file_info_set_attribute_uint32(inf.get(), G_FILE_ATTRIBUTE_UNIX_GID, 1000);
+    g_file_info_set_attribute_uint32(inf.get(), G_FILE_ATTRIBUTE_UNIX_NLINK, 1);
+    g_file_info_set_attribute_uint64(inf.get(), G_FILE_ATTRIBUTE_UNIX_INODE, 100000 + i);
+    g_file_info_set_attribute_uint32(inf.get(), G_FILE_ATTRIBUTE_UNIX_DEVICE, 2049);
+    g_file_info_set_attribute_uint64(inf.get(), G_FILE_ATTRIBUTE_TIME_MODIFIED, 1500000000 + i);
+    g_file_info_set_attribute_uint64(inf.get(), G_FILE_ATTRIBUTE_TIME_ACCESS, 1500000000 + i);
+    g_file_info_set_attribute_uint64(inf.get(), G_FILE_ATTRIBUTE_TIME_CHANGED, 1500000000 + i);
+    g_file_info_set_attribute_boolean(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_READ, true);
+    g_file_info_set_attribute_boolean(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_WRITE, true);
+    g_file_info_set_attribute_boolean(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_EXECUTE, false);
+    g_file_info_set_attribute_boolean(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_DELETE, true);
+    g_file_info_set_attribute_boolean(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_RENAME, true);
+    g_file_info_set_attribute_string(inf.get(), G_FILE_ATTRIBUTE_ID_FILESYSTEM, "l2049");
+    return inf;
+}
+
+static void measure(int n_files) {
+    // NOTE: the parent dir should not be native, or the files would be looked for on disk
+    auto dirPath = Fm::FilePath::fromUri("test:///folder");
+    Fm::FileInfoList files;
+    files.reserve(n_files);
+    makeGFileInfo(0); // load the content type icons first
+
+    size_t rss = residentSetSize();
+    QElapsedTimer timer;
+    timer.start();
+    for(int i = 0; i < n_files; ++i) {
+        files.push_back(std::make_shared<Fm::FileInfo>(makeGFileInfo(i), Fm::FilePath(), dirPath));
+    }
+    qint64 elapsed = timer.elapsed();
+    size_t growth = residentSetSize() - rss;
+
+    printf("%d files%s: %lld ms, RSS +%.1f MiB (%.1f bytes per file, sizeof(FileInfo) = %zu)\n", n_files,
+           Fm::FileInfo::leanMode() ? " (lean)" : "", (long long)elapsed,
+           growth / (1024.0 * 1024.0), n_files ? double(growth) / n_files : 0.0, sizeof(Fm::FileInfo));
+
+    // the sorting speed depends on how many cache lines are touched per file
+    std::shuffle(files.begin(), files.end(), std::mt19937{});
+    timer.restart();
+    std::sort(files.begin(), files.end(), [](const Fm::FileInfoPtr& a, const Fm::FileInfoPtr& b) {
+        return a->mtime() < b->mtime();
+    });
+    printf("sorting by mtime: %lld ms\n", (long long)timer.elapsed());
+
+    std::shuffle(files.begin(), files.end(), std::mt19937{});
+    timer.restart();
+    std::sort(files.begin(), files.end(), [](const Fm::FileInfoPtr& a, const Fm::FileInfoPtr& b) {
+        return a->displayName() < b->displayName();
+    });
+    printf("sorting by display name: %lld ms\n", (long long)timer.elapsed());
+    fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+
+    int n_files = 1000000;
+    int mode = -1; // both modes
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--lean") == 0) {
+            mode = 1;
+        }
+        else if(strcmp(argv[i], "--full") == 0) {
+            mode = 0;
+        }
+        else {
+            n_files = atoi(argv[i]);
+        }
+    }
+
+    if(mode >= 0) {
+        Fm::FileInfo::setLeanMode(mode == 1);
+        measure(n_files);
+        return 0;
+    }
+    for(bool lean : {false, true}) {
+        fflush(stdout);
+        pid_t pid = fork();
+        if(pid == 0) {
+            Fm::FileInfo::setLeanMode(lean);
+            measure(n_files);
+            _exit(0);
+        }
+        int status = 0;
+        if(pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
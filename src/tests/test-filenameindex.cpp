@@ -0,0 +1,175 @@
+// Checks the results of FileNameIndex against testing every name, while files are added,
+// renamed and removed, and measures the time taken by each query while a text is typed.
+// Then measures the whole cost of each keystroke for ProxyFolderModel::setQuickFilter(),
+// which includes refiltering the rows of the proxy model, with a view-less sorted model.
+// Usage: test-filenameindex [number of files]
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "../filenameindex.h"
+#include "../foldermodel.h"
+#include "../foldermodelitem.h"
+#include "../proxyfoldermodel.h"
+
+// exposes the slot that receives the files of the folder
+class TestModel: public Fm::FolderModel {
+public:
+    using Fm::FolderModel::onFilesAdded;
+};
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if(!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++failures; \
+        } \
+    } while(0)
+
+static Fm::FileInfoPtr makeFileInfo(const Fm::FilePath& dirPath, const std::string& name) {
+    Fm::GFileInfoPtr inf{g_file_info_new(), false};
+    g_file_info_set_file_type(inf.get(), G_FILE_TYPE_REGULAR);
+    g_file_info_set_name(inf.get(), name.c_str());
+    g_file_info_set_display_name(inf.get(), name.c_str());
+    g_file_info_set_content_type(inf.get(), "text/plain");
+    // NOTE: the parent dir is not native, or the files would be looked for on disk
+    return std::make_shared<Fm::FileInfo>(inf, Fm::FilePath(), dirPath);
+}
+
+static std::string makeName(std::mt19937& random, int i) {
+    static const char* const words[] = {"Report", "photo", "IMG_", "notes", "Backup", "draft", "Übersicht", "été"};
+    return std::string(words[random() % 8]) + ' ' + std::to_string(random() % 100000) + '-' + std::to_string(i) + ".txt";
+}
+
+// the index should match the same items as testing every name
+static void checkQuery(const Fm::FileNameIndex& index, const std::vector<std::unique_ptr<Fm::FolderModelItem>>& items) {
+    size_t count = 0;
+    for(const auto& item : items) {
+        bool expected = item->displayName().toCaseFolded().contains(index.query());
+        CHECK(index.matches(item.get()) == expected);
+        count += expected;
+    }
+    CHECK(index.matchCount() == count);
+}
+
+int main(int argc, char** argv) {
+    QApplication app(argc, argv);
+    const int n_files = argc > 1 ? atoi(argv[1]) : 1000000;
+
+    auto dirPath = Fm::FilePath::fromUri("test:///folder");
+    std::mt19937 random;
+    std::vector<std::unique_ptr<Fm::FolderModelItem>> items;
+    for(int i = 0; i < 10000; ++i) {
+        items.emplace_back(new Fm::FolderModelItem(makeFileInfo(dirPath, makeName(random, i))));
+    }
+    Fm::FileNameIndex index;
+    for(const auto& item : items) {
+        index.addItem(item.get());
+    }
+    CHECK(index.itemCount() == items.size());
+
+    // type a text, and then change it
+    const QString texts[] = {QStringLiteral("p"), QStringLiteral("ph"), QStringLiteral("pho"), QStringLiteral("PHOTO 1"),
+                             QStringLiteral("photo 12"), QStringLiteral("hoto 12"), QStringLiteral("ÉTÉ"), QStringLiteral("zzz")};
+    for(const auto& text : texts) {
+        index.setQuery(text);
+        checkQuery(index, items);
+    }
+
+    // add, rename and remove files while there is a query
+    index.setQuery(QStringLiteral("report"));
+    for(int i = 0; i < 1000; ++i) {
+        items.emplace_back(new Fm::FolderModelItem(makeFileInfo(dirPath, makeName(random, 10000 + i))));
+        index.addItem(items.back().get());
+    }
+    for(size_t i = 0; i < items.size(); i += 7) {
+        items[i]->info = makeFileInfo(dirPath, makeName(random, i));
+        index.addItem(items[i].get());
+    }
+    for(size_t i = 0; i < items.size(); i += 3) {
+        index.removeItem(items[i].get());
+    }
+    for(size_t i = 0; i < items.size(); i += 3) {
+        items[i] = nullptr;
+    }
+    items.erase(std::remove(items.begin(), items.end(), nullptr), items.end());
+    CHECK(index.itemCount() == items.size());
+    checkQuery(index, items);
+    index.setQuery(QStringLiteral("report 5"));
+    checkQuery(index, items);
+
+    // keep only half of the files
+    std::vector<const Fm::FolderModelItem*> kept;
+    for(size_t i = 0; i < items.size(); i += 2) {
+        kept.push_back(items[i].get());
+    }
+    index.syncItems(kept);
+    CHECK(index.itemCount() == kept.size());
+    for(size_t i = 1; i < items.size(); i += 2) {
+        items[i] = nullptr;
+    }
+    items.erase(std::remove(items.begin(), items.end(), nullptr), items.end());
+    checkQuery(index, items);
+
+    // measure the queries while a text is typed into a big index
+    items.clear();
+    index.clear();
+    QElapsedTimer timer;
+    timer.start();
+    for(int i = 0; i < n_files; ++i) {
+        items.emplace_back(new Fm::FolderModelItem(makeFileInfo(dirPath, makeName(random, i))));
+        index.addItem(items.back().get());
+    }
+    printf("%d files indexed in %lld ms\n", n_files, (long long)timer.elapsed());
+    const QString typed = QStringLiteral("photo 4321");
+    for(int len = 1; len <= typed.length(); ++len) {
+        timer.restart();
+        index.setQuery(typed.left(len));
+        printf("\"%s\": %zu files in %lld ms\n", typed.left(len).toUtf8().constData(), index.matchCount(), (long long)timer.elapsed());
+    }
+
+    // measure the keystrokes with a proxy model, while the text is typed and then erased
+    items.clear();
+    index.clear();
+    Fm::FileInfoList files;
+    files.reserve(n_files);
+    for(int i = 0; i < n_files; ++i) {
+        files.push_back(makeFileInfo(dirPath, makeName(random, i)));
+    }
+    TestModel model;
+    model.onFilesAdded(files);
+    Fm::ProxyFolderModel proxy;
+    proxy.setSourceModel(&model);
+    proxy.sort(Fm::FolderModel::ColumnFileName, Qt::AscendingOrder);
+    for(int len = 1; len <= typed.length(); ++len) {
+        timer.restart();
+        proxy.setQuickFilter(typed.left(len));
+        printf("proxy \"%s\": %d rows in %lld ms\n", typed.left(len).toUtf8().constData(), proxy.rowCount(), (long long)timer.elapsed());
+    }
+    int expected = 0;
+    for(const auto& file : files) {
+        expected += file->displayName().toCaseFolded().contains(typed.toCaseFolded());
+    }
+    CHECK(proxy.rowCount() == expected);
+    for(int len = typed.length() - 1; len >= 0; --len) {
+        timer.restart();
+        proxy.setQuickFilter(typed.left(len));
+        printf("proxy \"%s\": %d rows in %lld ms\n", typed.left(len).toUtf8().constData(), proxy.rowCount(), (long long)timer.elapsed());
+    }
+    CHECK(proxy.rowCount() == n_files);
+
+    if(failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
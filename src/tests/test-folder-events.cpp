@@ -0,0 +1,144 @@
+// Stress test for the handling of file monitor events by Fm::Folder.
+// Creates, changes and deletes many files in a watched folder, and checks
+// that the folder ends up with the same files as the directory, and that a
+// file added and deleted at once leaves no entry.
+// Usage: test-folder-events [number of files]
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QDebug>
+#include <cstdio>
+#include <set>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../core/folder.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if(!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++failures; \
+        } \
+    } while(0)
+
+static std::set<std::string> folderFileNames(const std::shared_ptr<Fm::Folder>& folder) {
+    std::set<std::string> names;
+    for(auto& file: folder->files()) {
+        names.insert(file->name());
+    }
+    return names;
+}
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+
+    const int n_files = argc > 1 ? QString::fromLocal8Bit(argv[1]).toInt() : 100000;
+    QTemporaryDir tmpDir;
+    const QByteArray dirName = QFile::encodeName(tmpDir.path());
+    auto folder = Fm::Folder::fromPath(Fm::FilePath::fromLocalPath(dirName.constData()));
+    while(!folder->isLoaded()) {
+        app.processEvents(QEventLoop::WaitForMoreEvents);
+    }
+    if(!folder->hasFileMonitor()) {
+        qWarning() << "no file monitor for" << tmpDir.path();
+        return 1;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    std::set<std::string> expected;
+    std::set<std::string> changed;
+    std::set<std::string> deleted;
+    int n_events = 0;
+    for(int i = 0; i < n_files; ++i) {
+        std::string name = "file-" + std::to_string(i);
+        std::string path = dirName.toStdString() + '/' + name;
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+        if(fd < 0) {
+            return 1;
+        }
+        ++n_events;
+        bool isChanged = false;
+        if(i % 5 == 0) { // change some files
+            if(write(fd, "x", 1) == 1) {
+                isChanged = true;
+                ++n_events;
+            }
+        }
+        close(fd);
+        if(i % 3 == 0) { // and delete some others right after adding them
+            unlink(path.c_str());
+            deleted.insert(name);
+            ++n_events;
+        }
+        else {
+            expected.insert(name);
+            if(isChanged) {
+                changed.insert(name);
+            }
+        }
+        // let the kernel event queue be read from time to time
+        if(i % 1000 == 999) {
+            app.processEvents();
+        }
+    }
+    qint64 generated = timer.elapsed();
+
+    // wait until the folder is in sync with the directory
+    bool synced = false;
+    while(!synced && timer.elapsed() < 120000) {
+        app.processEvents(QEventLoop::AllEvents, 100);
+        synced = (folder->files().size() == expected.size() && folderFileNames(folder) == expected);
+    }
+
+    qDebug("%d events generated in %lld ms, folder %s after %lld ms (%zu files expected, %zu found)",
+           n_events, generated, synced ? "synced" : "NOT synced", timer.elapsed(),
+           expected.size(), folder->files().size());
+
+    // the final file set after the burst
+    auto names = folderFileNames(folder);
+    CHECK(synced);
+    CHECK(folder->files().size() == expected.size());
+    CHECK(names == expected);
+    for(auto& name: deleted) {
+        CHECK(names.count(name) == 0);
+    }
+    for(auto& name: changed) {
+        auto file = folder->fileByName(name.c_str());
+        CHECK(file && file->size() == 1);
+    }
+
+    // a file that is added and deleted at once should not end up in the folder
+    // (the events are handled in order, so they are done once the marker file is there)
+    const std::string transientPath = dirName.toStdString() + "/transient";
+    int fd = open(transientPath.c_str(), O_WRONLY | O_CREAT, 0644);
+    CHECK(fd >= 0);
+    if(fd >= 0) {
+        close(fd);
+    }
+    unlink(transientPath.c_str());
+    fd = open((dirName.toStdString() + "/marker").c_str(), O_WRONLY | O_CREAT, 0644);
+    CHECK(fd >= 0);
+    if(fd >= 0) {
+        close(fd);
+    }
+    timer.restart();
+    while(!folder->fileByName("marker") && timer.elapsed() < 30000) {
+        app.processEvents(QEventLoop::AllEvents, 100);
+    }
+    CHECK(folder->fileByName("marker") != nullptr);
+    CHECK(folder->fileByName("transient") == nullptr);
+    CHECK(folder->files().size() == expected.size() + 1);
+
+    if(failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
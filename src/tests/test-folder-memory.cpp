@@ -0,0 +1,87 @@
+// Dumps the memory taken by loaded folders and their models.
+// Loads the given folders (the home folder by default), optionally with thumbnails
+// of the given size, and prints the memory usage of each one and of the whole process.
+// Usage: test-folder-memory [-t thumbnail size] [folder...]
+
+#include <QApplication>
+#include <QTimer>
+#include <QDebug>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "../core/folder.h"
+#include "../foldermodel.h"
+
+static void printUsage(const char* name, const Fm::Folder::MemoryUsage& usage, const Fm::FolderModel::MemoryUsage* modelUsage) {
+    const double kb = 1024.0;
+    printf("%s\n", name);
+    printf("  files:          %zu\n", usage.files);
+    printf("  FileInfo:       %10.1f KiB\n", usage.fileInfos / kb);
+    printf("  GFileInfo:      %10.1f KiB\n", usage.gFileInfos / kb);
+    printf("  display names:  %10.1f KiB\n", usage.displayNames / kb);
+    printf("  shared infos:   %10.1f KiB\n", usage.sharedInfos / kb);
+    if(modelUsage) {
+        printf("  model items:    %10.1f KiB\n", modelUsage->items / kb);
+        printf("  model strings:  %10.1f KiB\n", modelUsage->displayStrings / kb);
+        printf("  thumbnails:     %10.1f KiB\n", modelUsage->thumbnails / kb);
+    }
+    size_t total = usage.total() + (modelUsage ? modelUsage->total() : 0);
+    printf("  total:          %10.1f KiB (%.1f bytes per file)\n", total / kb,
+           usage.files ? double(total) / usage.files : 0.0);
+}
+
+int main(int argc, char** argv) {
+    QApplication app(argc, argv);
+
+    int thumbnailSize = 0;
+    std::vector<Fm::FilePath> paths;
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            thumbnailSize = atoi(argv[++i]);
+        }
+        else {
+            paths.push_back(Fm::FilePath::fromPathStr(argv[i]));
+        }
+    }
+    if(paths.empty()) {
+        paths.push_back(Fm::FilePath::homeDir());
+    }
+
+    std::vector<std::unique_ptr<Fm::FolderModel>> models;
+    for(auto& path: paths) {
+        auto model = std::unique_ptr<Fm::FolderModel>{new Fm::FolderModel()};
+        model->setFolder(Fm::Folder::fromPath(path));
+        models.push_back(std::move(model));
+    }
+    for(auto& model: models) {
+        while(!model->folder()->isLoaded()) {
+            app.processEvents(QEventLoop::WaitForMoreEvents);
+        }
+    }
+
+    if(thumbnailSize > 0) {
+        for(auto& model: models) {
+            model->cacheThumbnails(thumbnailSize);
+            for(int row = 0; row < model->rowCount(); ++row) {
+                model->thumbnailFromIndex(model->index(row, 0), thumbnailSize);
+            }
+        }
+        // wait for the thumbnails to be loaded
+        QTimer::singleShot(5000, &app, &QApplication::quit);
+        app.exec();
+    }
+
+    for(auto& model: models) {
+        auto modelUsage = model->memoryUsage();
+        printUsage(model->folder()->path().toString().get(), model->folder()->memoryUsage(), &modelUsage);
+    }
+
+    auto stats = Fm::Folder::cacheStats();
+    auto usage = Fm::Folder::totalMemoryUsage();
+    printf("\nprocess: %zu folders (%llu cache hits, %llu misses)\n", usage.folders,
+           (unsigned long long)stats.hits, (unsigned long long)stats.misses);
+    printUsage("all folders", usage, nullptr);
+    return 0;
+}
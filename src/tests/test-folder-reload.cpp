@@ -0,0 +1,84 @@
+// Counts the memory allocations made by Fm::Folder in the main thread while a
+// folder is reloaded, i.e., while the listed files are merged into the folder.
+// Usage: test-folder-reload [number of files]
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QDebug>
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../core/folder.h"
+
+// NOTE: malloc() and friends are replaced here to count the allocations of the main thread,
+// including those of GLib and Qt.
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+}
+
+static thread_local bool countAllocations = false;
+static std::atomic<size_t> allocationCount{0};
+
+extern "C" void* malloc(size_t size) {
+    if(countAllocations) {
+        ++allocationCount;
+    }
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t n, size_t size) {
+    if(countAllocations) {
+        ++allocationCount;
+    }
+    return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+    if(countAllocations && !ptr) {
+        ++allocationCount;
+    }
+    return __libc_realloc(ptr, size);
+}
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+
+    const int n_files = argc > 1 ? QString::fromLocal8Bit(argv[1]).toInt() : 100000;
+    QTemporaryDir tmpDir;
+    const std::string dirName = QFile::encodeName(tmpDir.path()).toStdString();
+    for(int i = 0; i < n_files; ++i) {
+        std::string path = dirName + "/file-" + std::to_string(i);
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+        if(fd < 0) {
+            return 1;
+        }
+        close(fd);
+    }
+
+    auto folder = Fm::Folder::fromPath(Fm::FilePath::fromLocalPath(dirName.c_str()));
+    while(!folder->isLoaded()) {
+        app.processEvents(QEventLoop::WaitForMoreEvents);
+    }
+
+    for(int i = 0; i < 3; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        allocationCount = 0;
+        countAllocations = true;
+        folder->reload();
+        while(!folder->isLoaded()) {
+            app.processEvents(QEventLoop::WaitForMoreEvents);
+        }
+        countAllocations = false;
+        size_t count = allocationCount;
+        printf("reload %d: %lld ms, %zu allocations in the main thread (%.1f per file)\n",
+               i + 1, (long long)timer.elapsed(), count, n_files ? double(count) / n_files : 0.0);
+    }
+    return folder->files().size() == size_t(n_files) ? 0 : 1;
+}
@@ -0,0 +1,248 @@
+// Checks the consistency of FolderModel while files are added, changed and removed, in the
+// spirit of QAbstractItemModelTester: the rows, the internal pointers of the indexes, the
+// persistent indexes and the signals about rows are checked after each change.
+// Usage: test-foldermodel
+
+#include <QApplication>
+#include <QPersistentModelIndex>
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "../foldermodel.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if(!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++failures; \
+        } \
+    } while(0)
+
+// exposes the slots that receive the changes of the folder
+class TestModel: public Fm::FolderModel {
+public:
+    using Fm::FolderModel::onFilesAdded;
+    using Fm::FolderModel::onFilesChanged;
+    using Fm::FolderModel::onFilesRemoved;
+};
+
+// counts the signals of the model and checks the row counts they announce
+struct SignalChecker {
+    explicit SignalChecker(TestModel& model) {
+        QObject::connect(&model, &QAbstractItemModel::rowsAboutToBeInserted, [&model, this](const QModelIndex& parent, int first, int last) {
+            CHECK(!parent.isValid());
+            CHECK(first == model.rowCount() && last >= first);
+            expectedCount = model.rowCount() + last - first + 1;
+        });
+        QObject::connect(&model, &QAbstractItemModel::rowsInserted, [&model, this](const QModelIndex&, int, int) {
+            CHECK(model.rowCount() == expectedCount);
+            ++inserts;
+        });
+        QObject::connect(&model, &QAbstractItemModel::rowsAboutToBeRemoved, [&model, this](const QModelIndex& parent, int first, int last) {
+            CHECK(!parent.isValid());
+            CHECK(first >= 0 && first <= last && last < model.rowCount());
+            expectedCount = model.rowCount() - (last - first + 1);
+        });
+        QObject::connect(&model, &QAbstractItemModel::rowsRemoved, [&model, this](const QModelIndex&, int, int) {
+            CHECK(model.rowCount() == expectedCount);
+            ++removals;
+        });
+        QObject::connect(&model, &QAbstractItemModel::layoutAboutToBeChanged, [this]() {
+            CHECK(!inLayoutChange);
+            inLayoutChange = true;
+        });
+        QObject::connect(&model, &QAbstractItemModel::layoutChanged, [this]() {
+            CHECK(inLayoutChange);
+            inLayoutChange = false;
+            ++layoutChanges;
+        });
+        QObject::connect(&model, &QAbstractItemModel::dataChanged, [&model, this](const QModelIndex& topLeft, const QModelIndex& bottomRight) {
+            CHECK(topLeft.isValid() && bottomRight.isValid());
+            CHECK(topLeft.model() == &model && topLeft.row() <= bottomRight.row());
+            ++dataChanges;
+        });
+    }
+
+    void reset() {
+        inserts = removals = layoutChanges = dataChanges = 0;
+    }
+
+    int expectedCount = 0;
+    int inserts = 0;
+    int removals = 0;
+    int layoutChanges = 0;
+    int dataChanges = 0;
+    bool inLayoutChange = false;
+};
+
+static Fm::FileInfoPtr makeFileInfo(const Fm::FilePath& dirPath, int i) {
+    std::string name = "file-" + std::to_string(i);
+    Fm::GFileInfoPtr inf{g_file_info_new(), false};
+    g_file_info_set_file_type(inf.get(), G_FILE_TYPE_REGULAR);
+    g_file_info_set_name(inf.get(), name.c_str());
+    g_file_info_set_display_name(inf.get(), name.c_str());
+    g_file_info_set_content_type(inf.get(), "text/plain");
+    g_file_info_set_size(inf.get(), i);
+    // NOTE: the parent dir is not native, or the files would be looked for on disk
+    return std::make_shared<Fm::FileInfo>(inf, Fm::FilePath(), dirPath);
+}
+
+// checks the rows of the model against the expected files
+static void checkModel(const TestModel& model, const Fm::FileInfoList& expected) {
+    CHECK(model.rowCount() == int(expected.size()));
+    CHECK(model.columnCount(QModelIndex()) == Fm::FolderModel::NumOfColumns);
+    CHECK(!model.index(-1, 0).isValid());
+    CHECK(!model.index(model.rowCount(), 0).isValid());
+    CHECK(!model.index(0, Fm::FolderModel::NumOfColumns).isValid());
+    for(int row = 0; row < model.rowCount() && row < int(expected.size()); ++row) {
+        QModelIndex index = model.index(row, 0);
+        CHECK(index.isValid() && index.row() == row && index.column() == 0);
+        CHECK(!model.parent(index).isValid());
+        CHECK(model.rowCount(index) == 0);
+        CHECK(model.itemFromIndex(index) == index.internalPointer());
+        CHECK(model.index(row, 1).internalPointer() == index.internalPointer());
+        CHECK(model.fileInfoFromIndex(index) == expected[row]);
+        CHECK(model.data(index, Qt::DisplayRole).toString() == expected[row]->displayName());
+    }
+}
+
+// keeps a persistent index of each row, with the item and file it should refer to
+struct PersistentRow {
+    QPersistentModelIndex index;
+    void* item;
+    Fm::FileInfoPtr info;
+};
+
+static std::vector<PersistentRow> makePersistentRows(const TestModel& model) {
+    std::vector<PersistentRow> rows;
+    for(int row = 0; row < model.rowCount(); ++row) {
+        QModelIndex index = model.index(row, 0);
+        rows.push_back({QPersistentModelIndex(index), index.internalPointer(), model.fileInfoFromIndex(index)});
+    }
+    return rows;
+}
+
+// the persistent indexes of the remaining files should still refer to the same items,
+// and those of the removed files should be invalid
+static void checkPersistentRows(const TestModel& model, const std::vector<PersistentRow>& rows, const Fm::FileInfoList& expected) {
+    for(const auto& row : rows) {
+        bool removed = std::find(expected.cbegin(), expected.cend(), row.info) == expected.cend();
+        if(removed) {
+            CHECK(!row.index.isValid());
+        }
+        else {
+            CHECK(row.index.isValid());
+            CHECK(row.index.internalPointer() == row.item);
+            CHECK(model.fileInfoFromIndex(row.index) == row.info);
+            CHECK(expected[row.index.row()] == row.info);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    QApplication app(argc, argv);
+
+    auto dirPath = Fm::FilePath::fromUri("test:///folder");
+    TestModel model;
+    SignalChecker checker{model};
+
+    // add the files in two batches
+    Fm::FileInfoList expected;
+    for(int batch = 0; batch < 2; ++batch) {
+        Fm::FileInfoList files;
+        for(int i = 0; i < 1000; ++i) {
+            files.push_back(makeFileInfo(dirPath, batch * 1000 + i));
+        }
+        model.onFilesAdded(files);
+        expected.insert(expected.end(), files.cbegin(), files.cend());
+    }
+    CHECK(checker.inserts == 2);
+    checkModel(model, expected);
+
+    // change every tenth file
+    auto persistentRows = makePersistentRows(model);
+    std::vector<Fm::FileInfoPair> changes;
+    for(size_t i = 0; i < expected.size(); i += 10) {
+        auto newInfo = std::make_shared<Fm::FileInfo>(*expected[i]);
+        changes.emplace_back(expected[i], newInfo);
+        expected[i] = newInfo;
+    }
+    checker.reset();
+    model.onFilesChanged(changes);
+    CHECK(checker.dataChanges == int(changes.size()));
+    checkModel(model, expected);
+    for(auto& row : persistentRows) {
+        row.info = model.fileInfoFromIndex(row.index);
+    }
+    checkPersistentRows(model, persistentRows, expected);
+
+    // remove a contiguous range of files and a few single files, in any order
+    Fm::FileInfoList removed;
+    for(int i = 299; i >= 100; --i) {
+        removed.push_back(expected[i]);
+    }
+    removed.push_back(expected[1999]);
+    removed.push_back(expected[0]);
+    removed.push_back(expected[500]);
+    for(const auto& info : removed) {
+        expected.erase(std::find(expected.begin(), expected.end(), info));
+    }
+    checker.reset();
+    model.onFilesRemoved(removed);
+    CHECK(checker.removals == 4);
+    CHECK(checker.layoutChanges == 0);
+    checkModel(model, expected);
+    checkPersistentRows(model, persistentRows, expected);
+
+    // remove every other file, which should be done in a single layout change
+    removed.clear();
+    Fm::FileInfoList remaining;
+    for(size_t i = 0; i < expected.size(); ++i) {
+        (i % 2 ? removed : remaining).push_back(expected[i]);
+    }
+    expected = remaining;
+    checker.reset();
+    model.onFilesRemoved(removed);
+    CHECK(checker.removals == 0);
+    CHECK(checker.layoutChanges == 1);
+    CHECK(!checker.inLayoutChange);
+    checkModel(model, expected);
+    checkPersistentRows(model, persistentRows, expected);
+
+    // add more files, which reuse the freed slots of the removed items
+    Fm::FileInfoList files;
+    for(int i = 2000; i < 2500; ++i) {
+        files.push_back(makeFileInfo(dirPath, i));
+    }
+    model.onFilesAdded(files);
+    expected.insert(expected.end(), files.cbegin(), files.cend());
+    checkModel(model, expected);
+    checkPersistentRows(model, persistentRows, expected);
+
+    // remove a file with another file info of the same name
+    removed.clear();
+    removed.push_back(std::make_shared<Fm::FileInfo>(*expected[10]));
+    expected.erase(expected.begin() + 10);
+    checker.reset();
+    model.onFilesRemoved(removed);
+    CHECK(checker.removals == 1);
+    checkModel(model, expected);
+
+    // remove all the files
+    checker.reset();
+    model.onFilesRemoved(expected);
+    expected.clear();
+    CHECK(checker.removals == 1);
+    checkModel(model, expected);
+    checkPersistentRows(model, persistentRows, expected);
+
+    if(failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
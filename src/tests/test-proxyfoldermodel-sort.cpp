@@ -0,0 +1,141 @@
+// Measures the time taken by ProxyFolderModel to sort files by name.
+// For each number of files (10k, 100k and 1M by default), sorts synthetic files by name
+// in both orders, and compares with sorting the same names with QCollator::compare().
+// Then sorts them by size in worker threads (see ProxyFolderModel::setAsyncSort()),
+// and adds them in batches of 1000 files to a sorted model, like an incremental loading
+// (including the time the last batches wait to be merged).
+// Usage: test-proxyfoldermodel-sort [number of files...]
+
+#include <QApplication>
+#include <QCollator>
+#include <QElapsedTimer>
+#include <QThread>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include "../foldermodel.h"
+#include "../proxyfoldermodel.h"
+
+// exposes the slot that receives the files of the folder
+class TestModel: public Fm::FolderModel {
+public:
+    using Fm::FolderModel::onFilesAdded;
+};
+
+static Fm::FileInfoPtr makeFileInfo(const Fm::FilePath& dirPath, unsigned int n, int i) {
+    static const char* const words[] = {"Report", "photo", "IMG_", "notes", "Backup", "draft", "Übersicht", "été"};
+    std::string name = std::string(words[n % 8]) + ' ' + std::to_string(n) + '-' + std::to_string(i) + ".txt";
+    Fm::GFileInfoPtr inf{g_file_info_new(), false};
+    g_file_info_set_file_type(inf.get(), G_FILE_TYPE_REGULAR);
+    g_file_info_set_name(inf.get(), name.c_str());
+    g_file_info_set_display_name(inf.get(), name.c_str());
+    g_file_info_set_content_type(inf.get(), "text/plain");
+    // NOTE: the parent dir is not native, or the files would be looked for on disk
+    return std::make_shared<Fm::FileInfo>(inf, Fm::FilePath(), dirPath);
+}
+
+static void benchmark(int n_files) {
+    auto dirPath = Fm::FilePath::fromUri("test:///folder");
+    std::mt19937 random;
+    Fm::FileInfoList files;
+    files.reserve(n_files);
+    for(int i = 0; i < n_files; ++i) {
+        files.push_back(makeFileInfo(dirPath, random() % 100000, i));
+    }
+
+    TestModel model;
+    model.onFilesAdded(files);
+    Fm::ProxyFolderModel proxy;
+    proxy.setSourceModel(&model);
+
+    QElapsedTimer timer;
+    timer.start();
+    proxy.sort(Fm::FolderModel::ColumnFileName, Qt::AscendingOrder);
+    qint64 first = timer.restart();
+    proxy.sort(Fm::FolderModel::ColumnFileName, Qt::DescendingOrder);
+    qint64 second = timer.restart();
+
+    // sorting the same names by comparing them with the collator
+    QCollator collator;
+    collator.setNumericMode(true);
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+    std::vector<QString> names;
+    names.reserve(n_files);
+    for(auto& info : files) {
+        names.push_back(info->displayName());
+    }
+    timer.restart();
+    std::sort(names.begin(), names.end(), [&collator](const QString& a, const QString& b) {
+        return collator.compare(a, b) < 0;
+    });
+    qint64 baseline = timer.elapsed();
+
+    printf("%d files: %lld ms (with making sort keys), %lld ms (reversed), %lld ms with QCollator::compare()\n",
+           n_files, (long long)first, (long long)second, (long long)baseline);
+
+    // sort in worker threads, and measure how long the event loop is blocked
+    Fm::ProxyFolderModel asyncProxy;
+    asyncProxy.setSourceModel(&model);
+    asyncProxy.setAsyncSort(true, 0);
+    qint64 blocked = 0;
+    QElapsedTimer blockTimer;
+    timer.restart();
+    blockTimer.start();
+    asyncProxy.sort(Fm::FolderModel::ColumnFileSize, Qt::AscendingOrder);
+    blocked = blockTimer.elapsed();
+    while(asyncProxy.isSorting()) {
+        blockTimer.restart();
+        QCoreApplication::processEvents();
+        blocked = std::max(blocked, blockTimer.elapsed());
+        QThread::msleep(1);
+    }
+    printf("%d files in worker threads: %lld ms, the event loop is blocked for %lld ms at most\n",
+           n_files, (long long)timer.elapsed(), (long long)blocked);
+}
+
+static void benchmarkBatches(int n_files) {
+    auto dirPath = Fm::FilePath::fromUri("test:///folder");
+    std::mt19937 random;
+    TestModel model;
+    Fm::ProxyFolderModel proxy;
+    proxy.setSourceModel(&model);
+    proxy.sort(Fm::FolderModel::ColumnFileName, Qt::AscendingOrder);
+
+    QElapsedTimer timer;
+    timer.start();
+    for(int i = 0; i < n_files;) {
+        Fm::FileInfoList files;
+        for(int j = 0; j < 1000 && i < n_files; ++j, ++i) {
+            files.push_back(makeFileInfo(dirPath, random() % 100000, i));
+        }
+        model.onFilesAdded(files);
+        // the batches are merged when the event loop runs (see ProxyFolderModel::onSourceRowsInserted())
+        QCoreApplication::processEvents();
+    }
+    // wait for the last batches to be merged
+    while(!proxy.dynamicSortFilter()) {
+        QCoreApplication::processEvents();
+        QThread::msleep(1);
+    }
+    printf("%d files added in batches of 1000 to a sorted model: %lld ms\n", n_files, (long long)timer.elapsed());
+}
+
+int main(int argc, char** argv) {
+    QApplication app(argc, argv);
+
+    std::vector<int> sizes;
+    for(int i = 1; i < argc; ++i) {
+        sizes.push_back(atoi(argv[i]));
+    }
+    if(sizes.empty()) {
+        sizes = {10000, 100000, 1000000};
+    }
+    for(int n_files : sizes) {
+        benchmark(n_files);
+        benchmarkBatches(n_files);
+    }
+    return 0;
+}
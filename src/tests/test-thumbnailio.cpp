@@ -0,0 +1,108 @@
+// Measures the I/O and the memory used by ThumbnailJob to generate the thumbnails of the images
+// in a folder, with local files mapped into memory or read through streams. Since the peak memory
+// usage of a process cannot be reset, each way of reading should be measured in its own process.
+// NOTE: Files modified in the last minute, and files on remote or FUSE file systems, are never
+// mapped, so the folder should be on a local disk, and the images copied just before the run
+// should be made older first (like with "touch -d '1 hour ago' <folder>/*").
+// Usage: test-thumbnailio <folder> [mmap|stream] [size]
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QFile>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/resource.h>
+#include "../core/dirlistjob.h"
+#include "../core/thumbnailjob.h"
+
+struct IoCounters {
+    long long rchar = -1; // the bytes read by read() and similar calls
+    long long readBytes = -1; // the bytes read from the storage, including the page faults of mappings
+};
+
+// the I/O counters of the process (on Linux)
+static IoCounters readIoCounters() {
+    IoCounters counters;
+    FILE* f = fopen("/proc/self/io", "r");
+    if(f) {
+        char name[64];
+        long long value;
+        while(fscanf(f, "%63s %lld", name, &value) == 2) {
+            if(strcmp(name, "rchar:") == 0) {
+                counters.rchar = value;
+            }
+            else if(strcmp(name, "read_bytes:") == 0) {
+                counters.readBytes = value;
+            }
+        }
+        fclose(f);
+    }
+    return counters;
+}
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        fprintf(stderr, "Usage: test-thumbnailio <folder> [mmap|stream] [size]\n");
+        return 1;
+    }
+    // NOTE: The cache directory should be set before GLib reads it.
+    QTemporaryDir cacheDir;
+    if(!cacheDir.isValid()) {
+        return 1;
+    }
+    qputenv("XDG_CACHE_HOME", QFile::encodeName(cacheDir.path()));
+    QCoreApplication app(argc, argv);
+
+    const bool mapped = argc < 3 || strcmp(argv[2], "stream") != 0;
+    const int size = argc > 3 ? atoi(argv[3]) : 128;
+
+    Fm::DirListJob listJob{Fm::FilePath::fromLocalPath(argv[1]), Fm::DirListJob::DETAILED};
+    listJob.setAutoDelete(false);
+    listJob.run(); // synchronous
+    Fm::FileInfoList files;
+    long long totalSize = 0;
+    for(const auto& file : listJob.files()) {
+        if(file->mimeType()->isImage()) {
+            files.push_back(file);
+            totalSize += file->size();
+        }
+    }
+
+    // one thread, so that the peak memory is that of one image
+    Fm::ThumbnailJob::setThreadCount(1);
+    Fm::ThumbnailJob::setMaxConcurrentReads(0);
+    Fm::ThumbnailJob::setMemoryCacheSize(0);
+    Fm::ThumbnailJob::setUseMappedFiles(mapped);
+
+    struct rusage usageBefore, usageAfter;
+    getrusage(RUSAGE_SELF, &usageBefore);
+    IoCounters ioBefore = readIoCounters();
+    QElapsedTimer timer;
+    timer.start();
+
+    Fm::ThumbnailJob job{files, size};
+    job.setAutoDelete(false);
+    Fm::ThumbnailJob::threadPool()->start(&job);
+    Fm::ThumbnailJob::threadPool()->waitForDone();
+
+    qint64 elapsed = timer.elapsed();
+    IoCounters ioAfter = readIoCounters();
+    getrusage(RUSAGE_SELF, &usageAfter);
+    int n_generated = 0;
+    for(const auto& image : job.results()) {
+        n_generated += !image.isNull();
+    }
+
+    printf("%s: %d of %d images (%lld KiB) in %lld ms\n", mapped ? "mmap" : "stream",
+           n_generated, int(files.size()), totalSize / 1024, (long long)elapsed);
+    if(ioBefore.rchar >= 0 && ioAfter.rchar >= 0) {
+        printf("copied by read(): %lld KiB, read from storage: %lld KiB\n",
+               (ioAfter.rchar - ioBefore.rchar) / 1024, (ioAfter.readBytes - ioBefore.readBytes) / 1024);
+    }
+    printf("page faults: %ld minor, %ld major\n", usageAfter.ru_minflt - usageBefore.ru_minflt,
+           usageAfter.ru_majflt - usageBefore.ru_majflt);
+    printf("peak memory: %ld KiB\n", usageAfter.ru_maxrss);
+    return 0;
+}
@@ -0,0 +1,92 @@
+// Measures the time taken by ThumbnailJob to make the thumbnails of the images in a folder
+// (like a folder of 5000 JPEG photos) with different numbers of threads. The thumbnails are
+// written to a temporary cache directory, which is emptied before each run. The speedup is
+// relative to the first number of threads (one thread by default, like the former serial pool).
+// Then the thumbnails are loaded again, from the memory cache of ThumbnailJob, and from the
+// thumbnail files after the memory cache is cleared.
+// Usage: test-thumbnails <folder> [number of threads...]
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QDir>
+#include <QFile>
+#include <QThread>
+#include <QDebug>
+#include <cstdio>
+#include <cstdlib>
+#include "../core/dirlistjob.h"
+#include "../core/thumbnailjob.h"
+
+static qint64 makeThumbnails(const Fm::FileInfoList& files, int size, int* n_loaded) {
+    Fm::ThumbnailJob job{files, size};
+    job.setAutoDelete(false);
+    QElapsedTimer timer;
+    timer.start();
+    Fm::ThumbnailJob::threadPool()->start(&job);
+    Fm::ThumbnailJob::threadPool()->waitForDone();
+    qint64 elapsed = timer.elapsed();
+    *n_loaded = 0;
+    for(const auto& image : job.results()) {
+        *n_loaded += !image.isNull();
+    }
+    return elapsed;
+}
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        fprintf(stderr, "Usage: test-thumbnails <folder> [number of threads...]\n");
+        return 1;
+    }
+    // NOTE: The cache directory should be set before GLib reads it.
+    QTemporaryDir cacheDir;
+    if(!cacheDir.isValid()) {
+        return 1;
+    }
+    qputenv("XDG_CACHE_HOME", QFile::encodeName(cacheDir.path()));
+    QCoreApplication app(argc, argv);
+
+    Fm::DirListJob listJob{Fm::FilePath::fromLocalPath(argv[1]), Fm::DirListJob::DETAILED};
+    listJob.setAutoDelete(false);
+    listJob.run(); // synchronous
+    Fm::FileInfoList files;
+    for(const auto& file : listJob.files()) {
+        if(file->mimeType()->isImage()) {
+            files.push_back(file);
+        }
+    }
+
+    QList<int> threadCounts;
+    for(int i = 2; i < argc; ++i) {
+        threadCounts.append(atoi(argv[i]));
+    }
+    if(threadCounts.isEmpty()) {
+        threadCounts = {1, QThread::idealThreadCount()};
+    }
+
+    qint64 firstGenerating = 0;
+    for(int n_threads : threadCounts) {
+        Fm::ThumbnailJob::setThreadCount(n_threads);
+        // generate the thumbnails, and then load them from the memory cache and from the files
+        QDir(cacheDir.path() + QStringLiteral("/thumbnails")).removeRecursively();
+        Fm::ThumbnailJob::clearMemoryCache();
+        int n_generated, n_fromMemory, n_loaded;
+        qint64 generating = makeThumbnails(files, 128, &n_generated);
+        auto statsBefore = Fm::ThumbnailJob::memoryCacheStats();
+        qint64 fromMemory = makeThumbnails(files, 128, &n_fromMemory);
+        auto statsAfter = Fm::ThumbnailJob::memoryCacheStats();
+        Fm::ThumbnailJob::clearMemoryCache();
+        qint64 loading = makeThumbnails(files, 128, &n_loaded);
+        if(firstGenerating == 0) {
+            firstGenerating = generating;
+        }
+        printf("%d threads: %d of %d images in %lld ms (%.1f per second, speedup %.2f), %d cached thumbnails loaded in %lld ms\n",
+               n_threads, n_generated, int(files.size()), (long long)generating,
+               generating > 0 ? n_generated * 1000.0 / generating : 0.0,
+               generating > 0 ? double(firstGenerating) / generating : 0.0, n_loaded, (long long)loading);
+        printf("    %d thumbnails got from the memory cache in %lld ms (%llu hits, %llu misses)\n",
+               n_fromMemory, (long long)fromMemory, (unsigned long long)(statsAfter.hits - statsBefore.hits),
+               (unsigned long long)(statsAfter.misses - statsBefore.misses));
+    }
+    return 0;
+}
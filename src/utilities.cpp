@@ -171,7 +171,7 @@ bool renameFile(std::shared_ptr<const Fm::FileInfo> file, QWidget* parent) {
     dlg.setWindowTitle(QObject::tr("Rename File"));
     dlg.setLabelText(QObject::tr("Please enter a new name:"));
     // NOTE: "Edit name" seems the best way to handle non-UTF8 filename encoding.
-    auto old_name = QString::fromUtf8(g_file_info_get_edit_name(file->gFileInfo().get()));
+    auto old_name = file->editName();
     if(old_name.isEmpty()) {
         old_name = QString::fromStdString(file->name());
     }